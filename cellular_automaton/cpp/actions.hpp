@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "physarum.hpp"
+using namespace std;
+
+// Directions an action points growth, energy or a signal in, in the order
+// of `dirs`.
+enum Dir : uint8_t { DIR_NONE, DIR_LEFT, DIR_RIGHT, DIR_UP, DIR_DOWN };
+
+constexpr char DIR_CHARS[5] = {'n', 'l', 'r', 'u', 'd'};
+constexpr int DIR_DX[5] = {0, -1, 1, 0, 0};
+constexpr int DIR_DY[5] = {0, 0, 0, 1, -1};
+
+// value a signal sent in that direction shifts into the receiver's memory
+constexpr uint8_t SIGNAL_VALUES[5] = {0, 0, 1, 2, 3};
+
+enum class Neighborhood { MOORE, VON_NEUMANN };
+
+struct ActionDecode {
+    Dir growth;
+    Dir energy;
+    Dir signal;
+};
+
+// decodes every action the way World::decodeGrowthDir, decodeEnergyDir and
+// decodeSignalDir do
+constexpr array<ActionDecode, ACTION_SPACE> makeActionTable() {
+    array<ActionDecode, ACTION_SPACE> table{};
+    for (int action = 0; action < ACTION_SPACE; action++) {
+        table[action].growth = action / 5 < 5 ? Dir(action / 5) : DIR_NONE;
+        table[action].energy = Dir(action % 5);
+        table[action].signal = Dir((action / 25) % 5);
+    }
+    return table;
+}
+
+constexpr array<ActionDecode, ACTION_SPACE> ACTION_TABLE = makeActionTable();
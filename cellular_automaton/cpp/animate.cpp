@@ -2,6 +2,8 @@
 #include <fstream>
 #include <sstream>
 #include "gen_alg.hpp"
+#include "keyframes.hpp"
+#include "rule_archive.hpp"
 #include <numeric>
 
 using namespace std;
@@ -13,47 +15,30 @@ int CELL_SIZE = 30;
 
 float FPS = 15.0f;
 
-World readWorld(int gen) {
+// steps between two keyframes; seeking re-simulates fewer steps than this
+int KEYFRAME_INTERVAL = 10;
 
-    ifstream file("best_individual.csv");
-    if (!file) throw runtime_error("Could not open file");
+// steps skipped by Page Up / Page Down
+int SEEK_JUMP = 10;
 
-    string line;
-    getline(file, line); // skip header
+World readWorld(int gen) {
 
-    string selectedLine, lastLine;
-    while (getline(file, line)) {
-        lastLine = line;
-        if (gen != -1) {
-            string genStr = line.substr(0, line.find(';'));
-            if (stoi(genStr) == gen) {
-                selectedLine = line;
-                break;
-            }
-        }
-    }
+    RuleArchive archive;
+    if (!archive.open(BEST_RULES_ARCHIVE) || archive.size() == 0) throw runtime_error("Could not open rule archive");
 
-    if (selectedLine.empty()) {
-        cout << "Generation not specified or not found, using last line." << endl;
-        selectedLine = lastLine;
+    int entry = gen != -1 ? archive.find(gen) : -1;
+    if (entry < 0) {
+        cout << "Generation not specified or not found, using last one." << endl;
+        entry = archive.size() - 1;
     }
 
-    stringstream ss(selectedLine);
-    string genStr, rulesStr, foodsStr;
-    getline(ss, genStr, ';');
-    getline(ss, rulesStr, ';');
-    getline(ss, foodsStr);
-
     vector<uint8_t> rules;
-    rules.reserve(256);
-    stringstream rulesStream(rulesStr);
-    for (string token; getline(rulesStream, token, ' ');)
-        if (!token.empty()) rules.push_back(static_cast<uint8_t>(stoi(token)));
-    
-    return World{{}, {}, rules};
+    archive.load(entry, rules);
+
+    return World{{}, {}, RuleTable(rules)};
 }
 
-void drawCells(sf::RenderWindow& window, vector<Cell>& cells) {
+void drawCells(sf::RenderWindow& window, vector<Cell>& cells, const Params& params) {
     int middleX = WIN_WIDTH / 2;
     int middleY = WIN_HEIGHT / 2;
 
@@ -63,7 +48,7 @@ void drawCells(sf::RenderWindow& window, vector<Cell>& cells) {
         int brightness = static_cast<int>(std::min(255.0f, std::max(50.0f, cell.energy * INITIAL_ENERGY / 10)));
         shape.setFillColor(sf::Color(brightness, brightness, 0));
         shape.setOutlineColor(sf::Color::Red);
-        if (cell.energy >= MIN_GROWTH_ENERGY) shape.setOutlineThickness(3);
+        if (cell.energy >= params.minGrowthEnergy) shape.setOutlineThickness(3);
         window.draw(shape);
     }
 }
@@ -92,12 +77,25 @@ void animate(int gen) {
     vector<Food> newFoods = getRandomizedFood();
     world.foods.insert(world.foods.end(), newFoods.begin(), newFoods.end());
     
+    Engines engines;
+
+    int step = 0;
+
+    // recorded in the background so that stepping back or seeking only
+    // replays from the nearest keyframe
+    Keyframes keyframes;
+    keyframes.start(world, KEYFRAME_INTERVAL, NUM_STEPS);
+
+    auto seek = [&](int target) {
+        step = std::max(0, std::min(NUM_STEPS, target));
+        world = keyframes.seek(step, engines);
+    };
+
     sf::RenderWindow window(sf::VideoMode(WIN_WIDTH, WIN_HEIGHT), "Physarum Polycephalum");
 
     sf::Clock clock;
     const float targetFrameTime = 1.f / FPS;
 
-    int step = 0;
     bool paused = false;
     while (window.isOpen()) {
 
@@ -115,11 +113,32 @@ void animate(int gen) {
                 vector<Food> newFoods = getRandomizedFood();
                 world.foods.insert(world.foods.end(), newFoods.begin(), newFoods.end());
                 step = 0;
+                keyframes.start(world, KEYFRAME_INTERVAL, NUM_STEPS);
+            }
+
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Left) {
+                if (paused && step > 0) seek(step - 1);
+            }
+
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::PageUp) {
+                seek(step + SEEK_JUMP);
+            }
+
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::PageDown) {
+                seek(step - SEEK_JUMP);
+            }
+
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Home) {
+                seek(0);
+            }
+
+            else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::End) {
+                seek(NUM_STEPS);
             }
 
             else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Right) {
                 if (paused && step < NUM_STEPS) {
-                    world = world.step();
+                    simulate(world, 1, engines);
                     step++;
                 }
             }
@@ -167,7 +186,7 @@ void animate(int gen) {
 
             window.clear();
 
-        drawCells(window, world.cells);
+        drawCells(window, world.cells, world.params);
         drawFoods(window, world.foods);
 
         window.display();
@@ -181,7 +200,7 @@ void animate(int gen) {
                     world.cells.begin(), world.cells.end(), 0.0f,
                     [](float sum, const Cell& c){ return sum + c.energy; })));
             if (!paused) {
-                world = world.step();
+                simulate(world, 1, engines);
                 step++;
                 sf::sleep(sf::seconds(targetFrameTime) - clock.getElapsedTime());
                 clock.restart();
@@ -201,6 +220,9 @@ int main(int argc, char*argv[]) {
 
     int gen = atoi(argv[0]);
 
+    // a single world is shown, so it gets every core
+    STEP_THREADS = max(1u, thread::hardware_concurrency());
+
     // cout << "Rules:" << endl;
     // int count = 0;
     // for (int rule : world.rules) {
@@ -0,0 +1,452 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "physarum.hpp"
+#include "actions.hpp"
+#include "visited_states.hpp"
+#include "grid_world.hpp"
+using namespace std;
+
+// Dense slot grid of one world in a batch, same layout as GridWorld's.
+struct BatchGrid {
+    RuleView rules;
+    Params params;
+
+    int originX = 0;
+    int originY = 0;
+    int width = 0;
+    int height = 0;
+
+    vector<int> cellAt;    // index into the batch columns, -1 if empty
+    vector<int> foodCount;
+    vector<int> claimAt;
+
+    int slotOf(int x, int y) const {
+        return (y - originY) * width + (x - originX);
+    }
+
+    int cellIndexAt(int x, int y) const {
+        return cellAt[slotOf(x, y)];
+    }
+
+    bool hasMargin(int x, int y) const {
+        return x - GRID_MARGIN >= originX && x + GRID_MARGIN < originX + width
+            && y - GRID_MARGIN >= originY && y + GRID_MARGIN < originY + height;
+    }
+};
+
+// neighbors a batch keeps a column of cell indices for: the four direct
+// ones in NEIGHBOR_OFFSETS order, then the diagonal ones read into state
+// codes (the third one being where World reads its down neighbor)
+const int NUM_BATCH_NEIGHBORS = 8;
+const int BATCH_NEIGHBOR_OFFSETS[NUM_BATCH_NEIGHBORS][2] = {
+    {0, -1}, {-1, 0}, {1, 0}, {0, 1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+
+// neighbor column a cell moving in a direction reaches; DIR_NONE reads
+// column 0, which the phases mask out
+constexpr int DIR_COLUMN[5] = {0, 1, 2, 3, 0};
+
+// direction a direct neighbor (in NEIGHBOR_OFFSETS order) moves in to reach
+// the cell
+constexpr Dir TOWARD_CELL[4] = {DIR_UP, DIR_RIGHT, DIR_LEFT, DIR_DOWN};
+
+// Runs many worlds in lockstep. The cells of all worlds live in one set
+// of columns (structure of arrays) tagged with their world id, so every
+// phase is a single pass over all worlds and the rule tables of a genome
+// stay hot in cache across its tries. Each world keeps its own slot grid,
+// but it is only read when cells were added: the indices of every cell's
+// neighbors are then gathered into neighbor columns, and the energy and
+// signal phases are branch-free passes over those, the same selects
+// GridWorld runs per slot. The passes still gather through neighbor
+// indices and per-world params, so unlike GridWorld's row loops they are
+// not laid out for the compiler to vectorize. Growth, food and the
+// bookkeeping of new cells stay serial. Each world gives exactly the cells
+// and foods GridWorld gives for it.
+struct BatchWorld {
+
+    // cell columns
+    vector<int> xs;
+    vector<int> ys;
+    vector<float> energies;
+    vector<char> energyDirs;
+    vector<uint8_t> memories;
+    vector<int> worldIds;
+
+    vector<Food> foods;
+    vector<int> foodWorlds;
+
+    // grids[0 .. worlds) belong to the current batch; the rest are kept
+    // around with their buffers for later batches
+    vector<BatchGrid> grids;
+    int worlds = 0;
+
+    // neighbor k of cell i at neighbors[k * numCells() + i], -1 if empty;
+    // stale once cells are added
+    vector<int> neighbors;
+    bool neighborsStale = true;
+
+    // back buffers and scratch buffers, kept across steps and batches
+    vector<float> nextEnergies;
+    vector<char> nextEnergyDirs;
+    vector<uint8_t> nextMemories;
+    vector<Cell> grown;
+    vector<int> grownWorlds;
+    vector<int> outgrown; // worlds whose grid has to be refitted
+    vector<uint16_t> stateCodes;
+    vector<uint8_t> actions;
+    vector<uint8_t> moves; // direction each cell passes energy or signals in
+
+    // every state code read from the rules of any world in the batch is
+    // marked here when set; not owned
+    VisitedStates* visited = nullptr;
+
+    int numWorlds() const {
+        return worlds;
+    }
+
+    int numCells() const {
+        return xs.size();
+    }
+
+    void clear() {
+        xs.clear(); ys.clear(); energies.clear();
+        energyDirs.clear(); memories.clear(); worldIds.clear();
+        foods.clear(); foodWorlds.clear();
+        worlds = 0;
+        neighborsStale = true;
+    }
+
+    // adds a world running on rules, which have to stay alive and unchanged
+    // while the batch is stepped; returns its world id
+    int addWorld(const RuleTable& rules, const Params& params, const vector<Cell>& cells, const vector<Food>& newFoods) {
+        int world = worlds++;
+        if (world == static_cast<int>(grids.size())) grids.emplace_back();
+        grids[world].rules = rules.view();
+        grids[world].params = params;
+        for (const Cell& cell : cells) pushCell(cell, world);
+        for (const Food& food : newFoods) {
+            foods.push_back(food);
+            foodWorlds.push_back(world);
+        }
+        rebuildGrid(world);
+        return world;
+    }
+
+    // writes the cells and foods of one world into out, leaving its rules alone
+    void exportTo(int world, World& out) const {
+        out.cells.clear();
+        for (int i = 0; i < numCells(); i++) {
+            if (worldIds[i] == world) out.cells.push_back(cellAt(i));
+        }
+        World::sortCells(out.cells);
+        out.foods.clear();
+        for (size_t f = 0; f < foods.size(); f++) {
+            if (foodWorlds[f] == world) out.foods.push_back(foods[f]);
+        }
+    }
+
+    void step() {
+        updateGrowth();
+        updateEnergy();
+        updateFood();
+        for (int i = 0; i < SIGNALS_PER_STEP; i++) {
+            updateSignals();
+        }
+    }
+
+    // ------------------- COLUMNS -------------------
+
+    Cell cellAt(int i) const {
+        return Cell{xs[i], ys[i], energies[i], energyDirs[i], memories[i]};
+    }
+
+    void pushCell(const Cell& cell, int world) {
+        xs.push_back(cell.x);
+        ys.push_back(cell.y);
+        energies.push_back(cell.energy);
+        energyDirs.push_back(cell.energyDir);
+        memories.push_back(cell.memory);
+        worldIds.push_back(world);
+        neighborsStale = true;
+    }
+
+    // fits the grid of one world around its cells and foods, same sizing
+    // as GridWorld::rebuildGrid
+    void rebuildGrid(int world) {
+        BatchGrid& grid = grids[world];
+
+        int minX = 0, maxX = 0, minY = 0, maxY = 0;
+        bool first = true;
+        auto include = [&](int x, int y) {
+            if (first) { minX = maxX = x; minY = maxY = y; first = false; return; }
+            minX = min(minX, x); maxX = max(maxX, x);
+            minY = min(minY, y); maxY = max(maxY, y);
+        };
+        for (int i = 0; i < numCells(); i++) {
+            if (worldIds[i] == world) include(xs[i], ys[i]);
+        }
+        for (size_t f = 0; f < foods.size(); f++) {
+            if (foodWorlds[f] == world) include(foods[f].x, foods[f].y);
+        }
+
+        int slackX = max(GRID_MARGIN, (maxX - minX + 1) / 2);
+        int slackY = max(GRID_MARGIN, (maxY - minY + 1) / 2);
+        grid.originX = minX - slackX;
+        grid.originY = minY - slackY;
+        grid.width = maxX - minX + 1 + 2 * slackX;
+        grid.height = maxY - minY + 1 + 2 * slackY;
+
+        grid.cellAt.assign(grid.width * grid.height, -1);
+        grid.foodCount.assign(grid.width * grid.height, 0);
+        grid.claimAt.assign(grid.width * grid.height, -1);
+
+        for (int i = 0; i < numCells(); i++) {
+            if (worldIds[i] == world) grid.cellAt[grid.slotOf(xs[i], ys[i])] = i;
+        }
+        for (size_t f = 0; f < foods.size(); f++) {
+            if (foodWorlds[f] == world && foods[f].energy > 0) grid.foodCount[grid.slotOf(foods[f].x, foods[f].y)]++;
+        }
+    }
+
+    // looks the neighbors of every cell up in the grids; cells only move
+    // when they are added, so this runs at most once per step
+    void gatherNeighbors() {
+        int n = numCells();
+        neighbors.resize(NUM_BATCH_NEIGHBORS * n);
+        for (int i = 0; i < n; i++) {
+            const BatchGrid& grid = grids[worldIds[i]];
+            for (int k = 0; k < NUM_BATCH_NEIGHBORS; k++) {
+                neighbors[k * n + i] = grid.cellIndexAt(xs[i] + BATCH_NEIGHBOR_OFFSETS[k][0], ys[i] + BATCH_NEIGHBOR_OFFSETS[k][1]);
+            }
+        }
+        neighborsStale = false;
+    }
+
+    // ------------------- PHASES -------------------
+
+    void updateGrowth() {
+
+        grown.clear();
+        grownWorlds.clear();
+
+        computeActions();
+
+        // claims are resolved in cell order, so this pass stays serial
+        for (int i = 0; i < numCells(); i++) {
+
+            BatchGrid& grid = grids[worldIds[i]];
+
+            Dir growthDir = ACTION_TABLE[actions[i]].growth;
+
+            if (growthDir == DIR_NONE || energies[i] < grid.params.minGrowthEnergy) continue;
+
+            int targetX = xs[i] + DIR_DX[growthDir];
+            int targetY = ys[i] + DIR_DY[growthDir];
+
+            // obstacles are checked against the cells from before this phase
+            int slot = grid.slotOf(targetX, targetY);
+            if (grid.cellAt[slot] >= 0 || grid.foodCount[slot] > 0) continue;
+
+            Cell child = Cell{targetX, targetY, energies[i] / 2, 'n'};
+            energies[i] /= 2;
+
+            // several cells growing into the same slot: the strongest wins
+            int &claim = grid.claimAt[slot];
+            if (claim < 0) {
+                claim = grown.size();
+                grown.push_back(child);
+                grownWorlds.push_back(worldIds[i]);
+            } else if (grown[claim].energy < child.energy) {
+                grown[claim] = child;
+            }
+        }
+
+        outgrown.clear();
+        for (size_t k = 0; k < grown.size(); k++) {
+            BatchGrid& grid = grids[grownWorlds[k]];
+            int slot = grid.slotOf(grown[k].x, grown[k].y);
+            grid.claimAt[slot] = -1;
+            grid.cellAt[slot] = numCells();
+            pushCell(grown[k], grownWorlds[k]);
+            if (!grid.hasMargin(grown[k].x, grown[k].y)) outgrown.push_back(grownWorlds[k]);
+        }
+        sort(outgrown.begin(), outgrown.end());
+        outgrown.erase(unique(outgrown.begin(), outgrown.end()), outgrown.end());
+        for (int world : outgrown) rebuildGrid(world);
+    }
+
+    void updateEnergy() {
+
+        computeActions();
+
+        int n = numCells();
+        const int* nb = neighbors.data();
+        const float* en = energies.data();
+        const char* dirs = energyDirs.data();
+        const uint8_t* mem = memories.data();
+        const uint8_t* act = actions.data();
+        moves.resize(n);
+        uint8_t* mv = moves.data();
+
+        // energy is only passed to an existing cell
+        for (int i = 0; i < n; i++) {
+            const Params& params = grids[worldIds[i]].params;
+            Dir dir = !(en[i] * params.energyPortion < params.minEnergyToPassEnergy) ? ACTION_TABLE[act[i]].energy : DIR_NONE;
+            mv[i] = nb[DIR_COLUMN[dir] * n + i] >= 0 ? dir : DIR_NONE;
+        }
+
+        nextEnergies.resize(n);
+        nextEnergyDirs.resize(n);
+        nextMemories.resize(n);
+        float* nextEn = nextEnergies.data();
+        char* nextDirs = nextEnergyDirs.data();
+        uint8_t* nextMem = nextMemories.data();
+
+        // a cell that received energy sums its own entry with every portion
+        // sent to it and is reset, in the order GridWorld::updateEnergy sums;
+        // adding 0 for a missing one leaves the sum unchanged
+        for (int i = 0; i < n; i++) {
+            bool from[4];
+            for (int k = 0; k < 4; k++) {
+                int sender = nb[k * n + i];
+                from[k] = (sender >= 0) & (mv[sender >= 0 ? sender : i] == TOWARD_CELL[k]);
+            }
+            bool received = from[0] | from[1] | from[2] | from[3];
+
+            const Params& params = grids[worldIds[i]].params;
+            bool sends = mv[i] != DIR_NONE;
+            float own = sends ? en[i] * (1 - params.energyPortion) : en[i];
+            float portion = en[i] * params.energyPortion;
+
+            float sum = 0;
+            sum += from[0] ? portion : 0.0f;
+            sum += from[1] ? portion : 0.0f;
+            sum += own;
+            sum += from[2] ? portion : 0.0f;
+            sum += from[3] ? portion : 0.0f;
+
+            nextEn[i] = received ? sum : own;
+            nextDirs[i] = received ? 'n' : (sends ? DIR_CHARS[mv[i]] : dirs[i]);
+            nextMem[i] = received ? 0 : mem[i];
+        }
+
+        swap(energies, nextEnergies);
+        swap(energyDirs, nextEnergyDirs);
+        swap(memories, nextMemories);
+    }
+
+    void updateFood() {
+
+        for (size_t f = 0; f < foods.size(); f++) {
+            Food & food = foods[f];
+            if (food.energy <= 0) continue;
+
+            BatchGrid& grid = grids[foodWorlds[f]];
+            for (const auto & offset : NEIGHBOR_OFFSETS) {
+                int cell = grid.cellIndexAt(food.x + offset[0], food.y + offset[1]);
+                if (cell < 0) continue;
+
+                food.energy -= 1;
+                energies[cell] += 1;
+                if (food.energy <= 0) break;
+            }
+            if (food.energy <= 0) grid.foodCount[grid.slotOf(food.x, food.y)]--;
+        }
+
+        // remove depleted foods
+        size_t kept = 0;
+        for (size_t f = 0; f < foods.size(); f++) {
+            if (foods[f].energy <= 0) continue;
+            foods[kept] = foods[f];
+            foodWorlds[kept] = foodWorlds[f];
+            kept++;
+        }
+        foods.resize(kept);
+        foodWorlds.resize(kept);
+    }
+
+    void updateSignals() {
+
+        computeActions();
+
+        int n = numCells();
+        const int* nb = neighbors.data();
+        const float* en = energies.data();
+        const uint8_t* mem = memories.data();
+        const uint8_t* act = actions.data();
+        moves.resize(n);
+        uint8_t* mv = moves.data();
+
+        // a signal is only sent to an existing cell
+        for (int i = 0; i < n; i++) {
+            Dir dir = !(en[i] < grids[worldIds[i]].params.minEnergyToSignal) ? ACTION_TABLE[act[i]].signal : DIR_NONE;
+            mv[i] = nb[DIR_COLUMN[dir] * n + i] >= 0 ? dir : DIR_NONE;
+        }
+
+        nextEnergies.resize(n);
+        nextMemories.resize(n);
+        float* nextEn = nextEnergies.data();
+        uint8_t* nextMem = nextMemories.data();
+        const uint8_t memoryMask = (1 << (MEMORY_SIZE*2)) - 1;
+
+        // receivers shift in the signals of their neighbors in row-major order
+        for (int i = 0; i < n; i++) {
+            nextEn[i] = mv[i] != DIR_NONE ? en[i] - grids[worldIds[i]].params.signalCost : en[i];
+
+            uint8_t m = mem[i];
+            for (int k = 0; k < 4; k++) {
+                int sender = nb[k * n + i];
+                bool from = (sender >= 0) & (mv[sender >= 0 ? sender : i] == TOWARD_CELL[k]);
+                m = from ? ((m << 2) | SIGNAL_VALUES[TOWARD_CELL[k]]) & memoryMask : m;
+            }
+            nextMem[i] = m;
+        }
+
+        swap(energies, nextEnergies);
+        swap(memories, nextMemories);
+    }
+
+    // ------------------- RULES -------------------
+
+    // state codes in the encoding of World::getCellState, and the action
+    // each cell's rules give for its code
+    void computeActions() {
+        if (neighborsStale) gatherNeighbors();
+
+        int n = numCells();
+        const int* nb = neighbors.data();
+        const char* dirs = energyDirs.data();
+        const uint8_t* mem = memories.data();
+        stateCodes.resize(n);
+        uint16_t* codes = stateCodes.data();
+        const uint8_t memoryMask = (1 << (MEMORY_SIZE*2)) - 1;
+
+        for (int i = 0; i < n; i++) {
+            int left = nb[1 * n + i], right = nb[2 * n + i], up = nb[0 * n + i];
+            int down = nb[6 * n + i]; // neighbor down, as read by World
+            uint16_t state = 0;
+            state |= (left >= 0);
+            state |= (right >= 0) << 1;
+            state |= (up >= 0) << 2;
+            state |= (down >= 0) << 3;
+            state |= ((left >= 0) & (dirs[left >= 0 ? left : i] == 'r')) << 4;
+            state |= ((right >= 0) & (dirs[right >= 0 ? right : i] == 'l')) << 5;
+            state |= ((up >= 0) & (dirs[up >= 0 ? up : i] == 'd')) << 6;
+            state |= ((down >= 0) & (dirs[down >= 0 ? down : i] == 'u')) << 7;
+            state |= (nb[4 * n + i] >= 0) << 8;
+            state |= (nb[5 * n + i] >= 0) << 9;
+            state |= (nb[7 * n + i] >= 0) << 11;
+            state |= static_cast<uint16_t>(mem[i] & memoryMask) << 12;
+            codes[i] = state;
+        }
+
+        actions.resize(n);
+        for (int i = 0; i < n; i++) {
+            actions[i] = grids[worldIds[i]].rules[codes[i]];
+        }
+        if (visited) {
+            for (int i = 0; i < n; i++) visited->mark(codes[i]);
+        }
+    }
+};
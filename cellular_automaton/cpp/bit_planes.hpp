@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+using namespace std;
+
+// Occupancy and energy direction of a grid packed as bit-planes, 64 cells
+// per word. The 12-bit neighborhood part of every cell's state code is
+// computed for a whole word at a time with shifts and ORs, instead of
+// looking up eight neighbors per cell.
+
+enum Plane { PLANE_OCCUPIED, PLANE_DIR_L, PLANE_DIR_R, PLANE_DIR_U, PLANE_DIR_D, NUM_PLANES };
+
+// number of neighborhood bits in a state code, below the memory bits
+const int NEIGHBORHOOD_BITS = 12;
+
+struct BitPlanes {
+    int width = 0;
+    int height = 0;
+
+    // words are processed in groups of four (one AVX2 register); every row
+    // is padded with a zero word on both sides and the planes with a zero
+    // row above and below, so shifted reads never leave the buffer
+    int groups = 0;
+    int stride = 0;
+    int planeSize = 0;
+
+    vector<uint64_t> words;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        groups = (w + 255) / 256;
+        stride = groups * 4 + 2;
+        planeSize = (h + 2) * stride;
+        words.assign(NUM_PLANES * planeSize, 0);
+    }
+
+    void clear() {
+        std::fill(words.begin(), words.end(), 0);
+    }
+
+    static int dirPlane(char dir) {
+        if (dir == 'l') return PLANE_DIR_L;
+        if (dir == 'r') return PLANE_DIR_R;
+        if (dir == 'u') return PLANE_DIR_U;
+        if (dir == 'd') return PLANE_DIR_D;
+        return -1;
+    }
+
+    // x and y are grid-local, 0 <= x < width, 0 <= y < height
+    void set(int plane, int x, int y) {
+        words[wordIndex(plane, x / 64, y)] |= uint64_t(1) << (x % 64);
+    }
+
+    // marks an occupied cell and the plane of its energy direction
+    void setCell(int x, int y, char energyDir) {
+        set(PLANE_OCCUPIED, x, y);
+        int plane = dirPlane(energyDir);
+        if (plane >= 0) set(plane, x, y);
+    }
+
+    int wordIndex(int plane, int word, int y) const {
+        return plane * planeSize + (y + 1) * stride + word + 1;
+    }
+
+    // Calls visit(x, y, code) for every occupied cell, with the neighborhood
+    // bits of World::getCellState:
+    //   0 left, 1 right, 2 up (y - 1), 3 down as read by World (x - 1, y + 1),
+    //   4..7 energy coming from those four, 8 left up, 9 right up,
+    //   10 never set (shadowed by bit 3), 11 right down.
+    // Only rows [firstRow, lastRow) are walked; disjoint row ranges can be
+    // walked from different threads.
+    template <typename Visit>
+    void forEachStateCode(Visit&& visit, int firstRow, int lastRow) const {
+        alignas(32) uint64_t masks[NEIGHBORHOOD_BITS][4];
+
+        for (int y = firstRow; y < lastRow; y++) {
+            for (int g = 0; g < groups; g++) {
+
+                const uint64_t* occ = &words[wordIndex(PLANE_OCCUPIED, g * 4, y)];
+                if ((occ[0] | occ[1] | occ[2] | occ[3]) == 0) continue;
+
+                computeMasks(g * 4, y, masks);
+
+                for (int i = 0; i < 4; i++) {
+                    uint64_t bits = occ[i];
+                    while (bits) {
+                        int b = __builtin_ctzll(bits);
+                        bits &= bits - 1;
+
+                        uint16_t code = 0;
+                        for (int k = 0; k < NEIGHBORHOOD_BITS; k++) {
+                            code |= ((masks[k][i] >> b) & 1) << k;
+                        }
+                        visit((g * 4 + i) * 64 + b, y, code);
+                    }
+                }
+            }
+        }
+    }
+
+    // masks[k][i] holds neighborhood bit k for the 64 cells of word
+    // (word + i) in row y
+    void computeMasks(int word, int y, uint64_t masks[NEIGHBORHOOD_BITS][4]) const {
+        const uint64_t* occUp = &words[wordIndex(PLANE_OCCUPIED, word, y - 1)];
+        const uint64_t* occ = &words[wordIndex(PLANE_OCCUPIED, word, y)];
+        const uint64_t* occDown = &words[wordIndex(PLANE_OCCUPIED, word, y + 1)];
+        const uint64_t* dirL = &words[wordIndex(PLANE_DIR_L, word, y)];
+        const uint64_t* dirR = &words[wordIndex(PLANE_DIR_R, word, y)];
+        const uint64_t* dirDUp = &words[wordIndex(PLANE_DIR_D, word, y - 1)];
+        const uint64_t* dirUDown = &words[wordIndex(PLANE_DIR_U, word, y + 1)];
+
+#ifdef __AVX2__
+        // bit b of fromLeft is bit b - 1 of the row, carried across words
+        auto load = [](const uint64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); };
+        auto fromLeft = [&](const uint64_t* p) {
+            return _mm256_or_si256(_mm256_slli_epi64(load(p), 1), _mm256_srli_epi64(load(p - 1), 63));
+        };
+        auto fromRight = [&](const uint64_t* p) {
+            return _mm256_or_si256(_mm256_srli_epi64(load(p), 1), _mm256_slli_epi64(load(p + 1), 63));
+        };
+        auto store = [&](int k, __m256i v) { _mm256_store_si256(reinterpret_cast<__m256i*>(masks[k]), v); };
+
+        store(0, fromLeft(occ));
+        store(1, fromRight(occ));
+        store(2, load(occUp));
+        store(3, fromLeft(occDown));
+        store(4, fromLeft(dirR));
+        store(5, fromRight(dirL));
+        store(6, load(dirDUp));
+        store(7, fromLeft(dirUDown));
+        store(8, fromLeft(occUp));
+        store(9, fromRight(occUp));
+        store(10, _mm256_setzero_si256());
+        store(11, fromRight(occDown));
+#else
+        auto fromLeft = [](const uint64_t* p) { return (p[0] << 1) | (p[-1] >> 63); };
+        auto fromRight = [](const uint64_t* p) { return (p[0] >> 1) | (p[1] << 63); };
+
+        for (int i = 0; i < 4; i++) {
+            masks[0][i] = fromLeft(occ + i);
+            masks[1][i] = fromRight(occ + i);
+            masks[2][i] = occUp[i];
+            masks[3][i] = fromLeft(occDown + i);
+            masks[4][i] = fromLeft(dirR + i);
+            masks[5][i] = fromRight(dirL + i);
+            masks[6][i] = dirDUp[i];
+            masks[7][i] = fromLeft(dirUDown + i);
+            masks[8][i] = fromLeft(occUp + i);
+            masks[9][i] = fromRight(occUp + i);
+            masks[10][i] = 0;
+            masks[11][i] = fromRight(occDown + i);
+        }
+#endif
+    }
+};
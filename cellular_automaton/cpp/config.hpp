@@ -0,0 +1,278 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <stdexcept>
+#include "physarum.hpp"
+using namespace std;
+
+// Defaults of the parameters of a genetic algorithm run, see Config.
+
+const int NUM_GENERATIONS = 1000;
+const int POPULATION_SIZE  = 40;
+const int NUM_TRIES = 20;
+
+// racing: after MIN_RACE_TRIES tries, an individual is not tried further
+// once mean + RACE_CONFIDENCE standard errors of its fitness falls below the
+// fitness of the last elite of the previous generation. It is ranked by the
+// mean of the tries it ran, so it may still make this generation's elite.
+// The batch engine runs every try and does not race.
+const int MIN_RACE_TRIES = 5;
+const float RACE_CONFIDENCE = 2.0f;
+
+const int NUM_STEPS = 100;
+
+const float ELITE_PROPORTION = 0.15f;
+// chance of each gene to mutate; the original coin flip test against 0.3
+// passed half the time, so 0.5 keeps its rate
+const float MUTATION_PROB = 0.5f;
+
+// if set, crossover and mutation only touch rules of states the last
+// generation visited; the other rules are inherited from the first parent
+// unchanged (focus_on_visited=true)
+const bool FOCUS_ON_VISITED = false;
+
+// if set, individuals whose genome equals that of an earlier individual
+// are not simulated again, they get its fitness instead of drawing their
+// own (skip_duplicate_genomes=true); duplicates are reported either way
+const bool SKIP_DUPLICATE_GENOMES = false;
+
+const float INITIAL_ENERGY = 100.0f;
+
+const int NUM_FOODS = 100;
+const float FOOD_ENERGY = 10.0f;
+const int MIN_FOOD_DIST = 0;
+const int MAX_FOOD_DIST = 20;
+
+enum class Engine { VECTOR, GRID, TILED, BATCH };
+
+const char* const ENGINE_NAMES[] = {"vector", "grid", "tiled", "batch"};
+
+Engine ENGINE = Engine::GRID;
+
+// ------------------- CONFIGURATION -------------------
+
+// Parameters of one genetic algorithm run, with the automaton's in world.
+// They are read from files and command line arguments as `key = value`,
+// keys being the names listed in forEachField.
+struct Config {
+    Params world;
+    Engine engine = ENGINE;
+
+    int numGenerations = NUM_GENERATIONS;
+    int populationSize = POPULATION_SIZE;
+    int numTries = NUM_TRIES;
+    int numSteps = NUM_STEPS;
+    int minRaceTries = MIN_RACE_TRIES;
+    float raceConfidence = RACE_CONFIDENCE;
+    float eliteProportion = ELITE_PROPORTION;
+    float mutationProb = MUTATION_PROB;
+    bool focusOnVisited = FOCUS_ON_VISITED;
+    bool skipDuplicateGenomes = SKIP_DUPLICATE_GENOMES;
+
+    float initialEnergy = INITIAL_ENERGY;
+    int numFoods = NUM_FOODS;
+    float foodEnergy = FOOD_ENERGY;
+    int minFoodDist = MIN_FOOD_DIST;
+    int maxFoodDist = MAX_FOOD_DIST;
+
+    uint32_t seed = 0;        // of the run's generators, 0 for a random one
+    int threads = 0;          // evaluation threads, 0 for one per core
+    string outputDir = ".";   // where the run writes its logs and archive
+
+    template <typename Self, typename Visit>
+    static void forEachField(Self& config, Visit&& visit) {
+        visit("engine", config.engine);
+        visit("num_generations", config.numGenerations);
+        visit("population_size", config.populationSize);
+        visit("num_tries", config.numTries);
+        visit("num_steps", config.numSteps);
+        visit("min_race_tries", config.minRaceTries);
+        visit("race_confidence", config.raceConfidence);
+        visit("elite_proportion", config.eliteProportion);
+        visit("mutation_prob", config.mutationProb);
+        visit("focus_on_visited", config.focusOnVisited);
+        visit("skip_duplicate_genomes", config.skipDuplicateGenomes);
+        visit("initial_energy", config.initialEnergy);
+        visit("num_foods", config.numFoods);
+        visit("food_energy", config.foodEnergy);
+        visit("min_food_dist", config.minFoodDist);
+        visit("max_food_dist", config.maxFoodDist);
+        visit("min_growth_energy", config.world.minGrowthEnergy);
+        visit("energy_portion", config.world.energyPortion);
+        visit("min_energy_to_pass_energy", config.world.minEnergyToPassEnergy);
+        visit("min_energy_to_signal", config.world.minEnergyToSignal);
+        visit("signal_cost", config.world.signalCost);
+        visit("seed", config.seed);
+        visit("threads", config.threads);
+        visit("output_dir", config.outputDir);
+    }
+
+    int numElite() const {
+        return populationSize * eliteProportion;
+    }
+
+    string path(const string& file) const {
+        return outputDir + "/" + file;
+    }
+
+    // throws invalid_argument for an unknown key or a malformed value
+    void set(const string& key, const string& value) {
+        bool found = false;
+        forEachField(*this, [&](const char* name, auto& field) {
+            if (key != name) return;
+            found = true;
+            try {
+                parseValue(value, field);
+            } catch (const logic_error&) {
+                throw invalid_argument("Bad value '" + value + "' for " + key);
+            }
+        });
+        if (!found) throw invalid_argument("Unknown parameter " + key);
+    }
+
+    // throws invalid_argument if the run could not work with these values
+    void check() const {
+        if (populationSize < 2 || numElite() < 1 || 2 * numElite() > populationSize) {
+            throw invalid_argument("population_size and elite_proportion leave no room for an elite and its children");
+        }
+        if (numTries < 1 || minRaceTries < 2) throw invalid_argument("num_tries has to be at least 1 and min_race_tries at least 2");
+        if (minFoodDist > maxFoodDist) throw invalid_argument("min_food_dist is above max_food_dist");
+        // the fitness is relative to the energy of all foods
+        if (numFoods < 1 || !(foodEnergy > 0)) throw invalid_argument("num_foods has to be at least 1 and food_energy positive");
+        if (numSteps < 0) throw invalid_argument("num_steps is negative");
+        if (!(mutationProb >= 0 && mutationProb <= 1)) throw invalid_argument("mutation_prob is not a probability");
+    }
+
+    void save(const string& file) const {
+        ofstream out(file);
+        forEachField(*this, [&](const char* name, const auto& field) {
+            out << name << " = " << formatValue(field) << "\n";
+        });
+    }
+
+    static void parseValue(const string& text, int& value) {
+        size_t used;
+        value = stoi(text, &used);
+        if (used != text.size()) throw invalid_argument(text);
+    }
+
+    // stoul would wrap negative numbers and cut off bits past 32
+    static void parseValue(const string& text, uint32_t& value) {
+        if (text.find('-') != string::npos) throw invalid_argument(text);
+        size_t used;
+        unsigned long long parsed = stoull(text, &used);
+        if (used != text.size() || parsed > UINT32_MAX) throw invalid_argument(text);
+        value = parsed;
+    }
+
+    static void parseValue(const string& text, float& value) {
+        size_t used;
+        value = stof(text, &used);
+        if (used != text.size()) throw invalid_argument(text);
+    }
+
+    static void parseValue(const string& text, bool& value) {
+        if (text != "true" && text != "false" && text != "1" && text != "0") throw invalid_argument(text);
+        value = text == "true" || text == "1";
+    }
+
+    static void parseValue(const string& text, string& value) {
+        value = text;
+    }
+
+    static void parseValue(const string& text, Engine& value) {
+        for (int e = 0; e < 4; e++) {
+            if (text == ENGINE_NAMES[e]) {
+                value = static_cast<Engine>(e);
+                return;
+            }
+        }
+        throw invalid_argument(text);
+    }
+
+    template <typename T>
+    static string formatValue(const T& value) {
+        ostringstream out;
+        out << value;
+        return out.str();
+    }
+
+    static string formatValue(bool value) {
+        return value ? "true" : "false";
+    }
+
+    static string formatValue(Engine value) {
+        return ENGINE_NAMES[static_cast<int>(value)];
+    }
+};
+
+// ------------------- SWEEPS -------------------
+
+static string trim(const string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos) return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Configurations given by args, applied in order: `key=value` sets a
+// parameter, anything else is a file of `key = value` lines (# starts a
+// comment). A value with commas is a list, and one configuration is made
+// for every combination of the lists (a sweep). The runs of a sweep write
+// into run_<i> under output_dir, and labels[i] names the list values of run
+// i. Throws invalid_argument on bad input.
+vector<Config> loadConfigs(const vector<string>& args, vector<string>& labels) {
+    vector<pair<string, string>> settings;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        if (eq != string::npos) {
+            settings.emplace_back(trim(arg.substr(0, eq)), trim(arg.substr(eq + 1)));
+            continue;
+        }
+        ifstream file(arg);
+        if (!file) throw invalid_argument("Could not open config file " + arg);
+        for (string line; getline(file, line);) {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+            eq = line.find('=');
+            if (eq == string::npos) throw invalid_argument("Expected key = value in " + arg + ": " + line);
+            settings.emplace_back(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        }
+    }
+
+    vector<Config> configs(1);
+    labels.assign(1, "");
+    for (const auto& [key, value] : settings) {
+        vector<string> values;
+        stringstream list(value);
+        for (string item; getline(list, item, ',');) values.push_back(trim(item));
+        if (values.empty()) values.push_back("");
+
+        if (values.size() == 1) {
+            for (Config& config : configs) config.set(key, values[0]);
+            continue;
+        }
+        vector<Config> expanded;
+        vector<string> expandedLabels;
+        for (size_t c = 0; c < configs.size(); c++) {
+            for (const string& v : values) {
+                expanded.push_back(configs[c]);
+                expanded.back().set(key, v);
+                expandedLabels.push_back(labels[c] + (labels[c].empty() ? "" : " ") + key + "=" + v);
+            }
+        }
+        configs = move(expanded);
+        labels = move(expandedLabels);
+    }
+
+    if (configs.size() > 1) {
+        for (size_t c = 0; c < configs.size(); c++) {
+            configs[c].outputDir += "/run_" + to_string(c);
+        }
+    }
+    for (const Config& config : configs) config.check();
+    return configs;
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "rule_archive.hpp"
+
+using namespace std;
+
+// Converts a best_individual.csv written by older versions of the genetic
+// algorithm into a rule archive.
+//
+//   convert_rules [csv] [archive]
+//
+// defaults to best_individual.csv and BEST_RULES_ARCHIVE; an existing
+// archive at the target path is overwritten.
+int main(int argc, char* argv[]) {
+
+    string csvPath = argc > 1 ? argv[1] : "best_individual.csv";
+    string archivePath = argc > 2 ? argv[2] : BEST_RULES_ARCHIVE;
+
+    ifstream file(csvPath);
+    if (!file) {
+        cerr << "Could not open " << csvPath << endl;
+        return 1;
+    }
+
+    RuleArchiveWriter archive(archivePath, false);
+
+    string line;
+    getline(file, line); // skip header
+
+    int converted = 0;
+    vector<uint8_t> rules;
+    while (getline(file, line)) {
+        if (line.empty()) continue;
+
+        stringstream ss(line);
+        string genStr, rulesStr;
+        getline(ss, genStr, ';');
+        getline(ss, rulesStr, ';');
+
+        rules.clear();
+        stringstream rulesStream(rulesStr);
+        for (string token; getline(rulesStream, token, ' ');)
+            if (!token.empty()) rules.push_back(static_cast<uint8_t>(stoi(token)));
+
+        if (rules.size() != STATE_SPACE) {
+            cerr << "Skipping generation " << genStr << ": " << rules.size() << " rules instead of " << STATE_SPACE << endl;
+            continue;
+        }
+
+        archive.append(stoi(genStr), RuleTable(rules));
+        converted++;
+    }
+
+    cout << "Converted " << converted << " generations into " << archivePath << ".bin/.idx" << endl;
+    return 0;
+}
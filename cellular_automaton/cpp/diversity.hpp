@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "physarum.hpp"
+#include "genome_kernels.hpp"
+using namespace std;
+
+// Pairwise Hamming distances (number of differing genes) between the rule
+// tables of a population. The pages of all tables are compared page by page,
+// so the pages being compared stay in cache, and pages two tables share are
+// skipped without reading them.
+struct Diversity {
+    int size = 0;
+    vector<int> distances; // distances[i * size + j]
+
+    float meanDistance = 0; // over all pairs i < j
+    int minDistance = 0;
+    int distinctGenomes = 0;
+
+    // duplicateOf[i] is the first individual with the same genome as i (i
+    // itself if there is none before it)
+    vector<int> duplicateOf;
+
+    int distance(int i, int j) const {
+        return distances[i * size + j];
+    }
+
+    static Diversity of(const vector<World>& population) {
+        Diversity d;
+        d.size = population.size();
+        d.distances.assign(d.size * d.size, 0);
+
+        int numPages = d.size > 0 ? population.front().rules.numPages() : 0;
+        for (int p = 0; p < numPages; p++) {
+            for (int i = 0; i < d.size; i++) {
+                const RuleTable& a = population[i].rules;
+                for (int j = i + 1; j < d.size; j++) {
+                    const RuleTable& b = population[j].rules;
+                    if (a.sharesPage(b, p)) continue;
+                    d.distances[i * d.size + j] += hammingDistance(a.page(p), b.page(p), RULE_PAGE_SIZE);
+                }
+            }
+        }
+
+        long long sum = 0;
+        d.minDistance = d.size > 1 ? STATE_SPACE : 0;
+        d.duplicateOf.resize(d.size);
+        for (int i = 0; i < d.size; i++) {
+            d.duplicateOf[i] = i;
+            for (int j = i + 1; j < d.size; j++) {
+                int dist = d.distances[i * d.size + j];
+                d.distances[j * d.size + i] = dist;
+                sum += dist;
+                d.minDistance = min(d.minDistance, dist);
+            }
+            for (int j = 0; j < i; j++) {
+                if (d.distances[j * d.size + i] == 0) {
+                    d.duplicateOf[i] = d.duplicateOf[j];
+                    break;
+                }
+            }
+            d.distinctGenomes += d.duplicateOf[i] == i;
+        }
+        long long pairs = static_cast<long long>(d.size) * (d.size - 1) / 2;
+        d.meanDistance = pairs > 0 ? static_cast<float>(sum) / pairs : 0.0f;
+        return d;
+    }
+};
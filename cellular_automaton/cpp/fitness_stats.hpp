@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "physarum.hpp"
+using namespace std;
+
+// distances from the origin are summed in fixed point with this many steps
+// per unit, so the sum does not depend on the order cells are added in
+const double DISTANCE_SCALE = 1 << 20;
+
+// Running totals the fitness terms are computed from. The grid engine keeps
+// them up to date while it steps, so fitness is O(1) at the end of a run and
+// can be looked at after any step; for a plain World they are gathered in a
+// single pass with of().
+struct FitnessStats {
+    int cells = 0;
+    int lowEnergyCells = 0;  // cells below minGrowthEnergy
+    int64_t distanceSum = 0; // sum of cell distances from the origin, fixed point
+    float foodEnergy = 0;    // energy left in all foods
+
+    // bounding box of the cells, empty while there are none
+    int minX = 0;
+    int maxX = -1;
+    int minY = 0;
+    int maxY = -1;
+
+    static int64_t fixedDistance(int x, int y) {
+        return llround(std::sqrt(static_cast<double>(x * x + y * y)) * DISTANCE_SCALE);
+    }
+
+    // cells never move or die, so a cell only has to be counted once
+    void addCell(int x, int y) {
+        if (cells == 0) {
+            minX = maxX = x;
+            minY = maxY = y;
+        } else {
+            minX = min(minX, x); maxX = max(maxX, x);
+            minY = min(minY, y); maxY = max(maxY, y);
+        }
+        cells++;
+        distanceSum += fixedDistance(x, y);
+    }
+
+    float averageDistance() const {
+        return static_cast<float>(distanceSum / DISTANCE_SCALE / cells);
+    }
+
+    static FitnessStats of(const World& world) {
+        FitnessStats stats;
+        for (const Cell& cell : world.cells) {
+            stats.addCell(cell.x, cell.y);
+            if (cell.energy < world.params.minGrowthEnergy) stats.lowEnergyCells++;
+        }
+        for (const Food& food : world.foods) {
+            stats.foodEnergy += food.energy;
+        }
+        return stats;
+    }
+};
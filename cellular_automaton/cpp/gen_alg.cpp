@@ -1,4 +1,6 @@
 #include "gen_alg.hpp"
+#include "rule_archive.hpp"
+#include "diversity.hpp"
 #include <iostream>
 #include <random>
 #include <cstdint>
@@ -11,105 +13,59 @@ using namespace std;
 #include <regex>
 
 #include <chrono>
+#include <limits>
 
-// ---------------------------- FITNESS ----------------------------
-
-float energyCentrality(World& world) {
-    if (world.cells.empty()) return 0.0f;
-
-    float totalDist = 0.0f;
-    for (const Cell& cell : world.cells) {
-        totalDist += std::sqrt(cell.x * cell.x + cell.y * cell.y);
-    }
-
-    float avgDist = totalDist / (world.cells.size());
-    return 1.0f / (avgDist + 1.0f);
-}
-
-float spread(World& world) {
-    if (world.cells.empty()) return 0.0f;
-
-    int minX = world.cells[0].x;
-    int maxX = world.cells[0].x;
-    int minY = world.cells[0].y;
-    int maxY = world.cells[0].y;
-
-    for (const Cell& cell : world.cells) {
-        if (cell.x < minX) minX = cell.x;
-        if (cell.x > maxX) maxX = cell.x;
-        if (cell.y < minY) minY = cell.y;
-        if (cell.y > maxY) maxY = cell.y;
-    }
-
-    float spread = std::round(static_cast<float>((maxX - minX) + (maxY - minY)) * 100.0f) / 100.0f;
-    return spread;
-}
+// ------------------- GENETIC ALGORITHM LOGGING -------------------
 
-float totalCellsEnergy(World& world) {
-    float energy = 0;
-    for (const Cell& cell: world.cells) {
-        energy += cell.energy;
-    }
-    return energy;
-}
 
-float totalAcquiredEnergy(World& world) {
-    float totalFoodEnergy = NUM_FOODS * FOOD_ENERGY;
-    float energy = 0;
-    for (const Food& food: world.foods) {
-        energy += food.energy;
-    }
-    return std::round((totalFoodEnergy - energy) / totalFoodEnergy * 100.0f) / 100.0f;
+void saveBestRules(RuleArchiveWriter& archive, const vector<World>& population, int generation) {
+    archive.append(generation, population.front().rules);
 }
 
-float totalCells(World& world) {
-    return static_cast<float>(world.cells.size());
-}
-
-float droughtResistance(World& world) {
-    int nonFullCells = 0;
-    for (const Cell& cell : world.cells) {
-        if (cell.energy < MIN_GROWTH_ENERGY) nonFullCells++;
-    }
-    return std::round(static_cast<float>(nonFullCells) / static_cast<float>(world.cells.size()) * 100.0f) / 100.0f;
-}
-
-void sortByFitness(vector<World>& population) {
-    std::sort(population.begin(), population.end(),
-    [](const World& a, const World& b) {
-        return a.fitness > b.fitness;
+// appends how much of the rule table the generation visited and rewrites
+// visited_states.csv with the number of individuals that visited each state
+void saveVisitedStates(const vector<VisitedStates>& visited, const VisitedStates& merged, int generation, const Config& config) {
+    std::ofstream history(config.path("visited_history.csv"), std::ios::app);
+    if (history.tellp() == 0) history << "generation;visited;fraction\n";
+
+    int count = merged.count();
+    history << generation << ";" << count << ";" << static_cast<float>(count) / STATE_SPACE << "\n";
+
+    std::ofstream file(config.path("visited_states.csv"));
+    file << "state;individuals\n";
+    merged.forEach([&](uint32_t code) {
+        int individuals = 0;
+        for (const VisitedStates& v : visited) individuals += v.test(code);
+        file << code << ";" << individuals << "\n";
     });
 }
 
-float calculateFitness(World& world) {
-    return 
-        totalAcquiredEnergy(world)
-        + 0.01f * energyCentrality(world)
-        + 0.03f * droughtResistance(world);
-    // return spreadFitness(world);
-    // return energyCentralityFitness(world);
+// appends the diversity summary of the generation and rewrites
+// diversity_matrix.csv with its pairwise distances, in evaluation order
+void saveDiversity(const Diversity& diversity, int generation, const Config& config) {
+    std::ofstream history(config.path("diversity_history.csv"), std::ios::app);
+    if (history.tellp() == 0) history << "generation;mean;min;distinct\n";
+    history << generation << ";" << diversity.meanDistance << ";" << diversity.minDistance
+            << ";" << diversity.distinctGenomes << "\n";
+
+    std::ofstream file(config.path("diversity_matrix.csv"));
+    for (int i = 0; i < diversity.size; i++) {
+        for (int j = 0; j < diversity.size; j++) {
+            file << diversity.distance(i, j) << (j + 1 < diversity.size ? ";" : "\n");
+        }
+    }
 }
 
-// ------------------- GENETIC ALGORITHM LOGGING -------------------
-
-
-void saveBestRules(const vector<World>& population, int generation) {
-    const World& best = population.front();
-
-    std::ofstream file("best_individual.csv", std::ios::app);
-    if (file.tellp() == 0) file << "generation;rules\n";
-
-    file << generation << ";";
-    for (size_t i = 0; i < best.rules.size(); i++) {
-        file << static_cast<int>(best.rules[i]);
-        if (i < best.rules.size() - 1) file << " ";
-    }
-    file << "\n";   
+// appends how many tries the generation simulated and how many racing saved
+void saveRacing(int tries, int generation, const Config& config) {
+    std::ofstream file(config.path("racing_history.csv"), std::ios::app);
+    if (file.tellp() == 0) file << "generation;tries;saved\n";
+    file << generation << ";" << tries << ";" << config.populationSize * config.numTries - tries << "\n";
 }
 
-void saveFitnessHistory(const vector<World>& population, int generation) {
+void saveFitnessHistory(const vector<World>& population, int generation, const Config& config) {
     // Open file in append mode
-    std::ofstream file("fitness_history.csv", std::ios::app);
+    std::ofstream file(config.path("fitness_history.csv"), std::ios::app);
     if (file.tellp() == 0) file << "generation;best;average\n";
 
     // Compute stats
@@ -124,25 +80,26 @@ void saveFitnessHistory(const vector<World>& population, int generation) {
 
 // ------------------- GENETIC ALGORITHM OPERATIONS -------------------
 
-void generateInitialPopulation(vector<World>& population) {
-    for (int i = 0; i < POPULATION_SIZE; i++) {
+void generateInitialPopulation(vector<World>& population, const Config& config, std::mt19937& rng, FastRng& genomeRng) {
+    for (int i = 0; i < config.populationSize; i++) {
         World world;
-        world.cells.push_back(Cell{0, 0, INITIAL_ENERGY, 'n', 1});
-        vector<Food> newFoods = getRandomizedFood();
+        world.params = config.world;
+        world.cells.push_back(Cell{0, 0, config.initialEnergy, 'n', 1});
+        vector<Food> newFoods = getRandomizedFood(config, rng);
         world.foods.insert(world.foods.end(), newFoods.begin(), newFoods.end());
-        for (int s = 0; s < STATE_SPACE; s++) {
-            world.rules.push_back(randAction());
+        world.rules = RuleTable(STATE_SPACE);
+        for (int p = 0; p < world.rules.numPages(); p++) {
+            fillRandomActions(world.rules.writablePage(p), RULE_PAGE_SIZE, ACTION_SPACE, genomeRng);
         }
         population.push_back(world);
     }
 }
 
-vector<World> selectElite(vector<World> population) { 
-    int numElite = POPULATION_SIZE * ELITE_PROPORTION;
-    return vector<World>(population.begin(), population.begin() + numElite);
+vector<World> selectElite(const vector<World>& population, const Config& config) { 
+    return vector<World>(population.begin(), population.begin() + config.numElite());
 }
 
-vector<World> crossover(const vector<World>& parents) {
+vector<World> crossover(const vector<World>& parents, const VisitedStates* focus, FastRng& rng) {
     vector<World> children;
 
     int numParents = parents.size();
@@ -151,12 +108,29 @@ vector<World> crossover(const vector<World>& parents) {
         const World& parent2 = parents[(i + 1) % numParents]; // wrap-around pairing
 
         World child;
-        child.rules.resize(STATE_SPACE);
+        child.params = parent1.params;
+
+        if (focus) {
+            // genes of states nobody visited come from parent1 as a block
+            child.rules = parent1.rules;
+            uint64_t bits = 0;
+            int left = 0;
+            focus->forEach([&](uint32_t j) {
+                if (left == 0) { bits = rng.next(); left = 64; }
+                if ((bits & 1) && parent2.rules[j] != child.rules[j]) child.rules.set(j, parent2.rules[j]);
+                bits >>= 1;
+                left--;
+            });
+            children.push_back(child);
+            continue;
+        }
 
-        for (int j = 0; j < STATE_SPACE; j++) {
-            // choose gene from parent1 or parent2
-            std::bernoulli_distribution takeFromP1(0.5);
-            child.rules[j] = takeFromP1(globalRng()) ? parent1.rules[j] : parent2.rules[j];
+        // choose every gene from parent1 or parent2; pages the parents share
+        // are shared by the child as well
+        child.rules = parent1.rules;
+        for (int p = 0; p < child.rules.numPages(); p++) {
+            if (parent1.rules.sharesPage(parent2.rules, p)) continue;
+            crossoverRules(parent1.rules.page(p), parent2.rules.page(p), child.rules.newPage(p), RULE_PAGE_SIZE, rng);
         }
 
         children.push_back(child);
@@ -165,144 +139,288 @@ vector<World> crossover(const vector<World>& parents) {
     return children;
 }
 
-void mutate(vector<World>& inds, const float& mutationProb) {
-    std::random_device rd;
-    std::mt19937 generate(rd());
-    std::uniform_int_distribution<uint8_t> actionDist(0, 24);
-    std::mt19937 rng(std::random_device{}());
+// every gene (of the focus states, if set) is replaced by a random action in
+// 0..24 with probability mutationProb
+void mutate(vector<World>& inds, const float& mutationProb, const VisitedStates* focus, FastRng& rng) {
+    const int MUTATION_ACTIONS = 25;
+
+    vector<uint32_t> focusStates;
+    if (focus) focus->forEach([&](uint32_t j) { focusStates.push_back(j); });
+
     for (World & ind : inds) {
-        for (uint8_t & r : ind.rules) { 
-            if (getRandomCoinFlip() < mutationProb) {
-                r = actionDist(rng);
-            }
+        if (focus) {
+            forEachMutation(focusStates.size(), mutationProb, rng, [&](size_t k) {
+                ind.rules.set(focusStates[k], rng.below(MUTATION_ACTIONS));
+            });
+            continue;
         }
+        forEachMutation(ind.rules.size(), mutationProb, rng, [&](size_t j) {
+            ind.rules.set(j, rng.below(MUTATION_ACTIONS));
+        });
     }
 }
 
-vector<World> generateNextPopulation(const vector<World>& population) {
+// focus, if set, restricts crossover and mutation to the states in it
+vector<World> generateNextPopulation(const vector<World>& population, const VisitedStates* focus, const Config& config,
+                                     std::mt19937& rng, FastRng& genomeRng) {
     vector<World> offsprings;
-    vector<World> elite = selectElite(population);
+    vector<World> elite = selectElite(population, config);
     offsprings.insert(offsprings.end(), elite.begin(), elite.end());
-    vector<World> eliteChildren = crossover(elite);
+    vector<World> eliteChildren = crossover(elite, focus, genomeRng);
 
     // float similarity = population[POPULATION_SIZE / 2].fitness / population[0].fitness;
     // float similarityPunishment = std::max(1.0f, similarity * SIM_PUNISH_FACTOR);
     // cout << "Similarity punishment: " << similarityPunishment << "\n";
     // float mutationProb = std::min(1.0f, (MUTATION_PROPORTION * similarityPunishment));
-    cout << "Mutation probability: " << MUTATION_PROB << "\n";
-    mutate(eliteChildren, MUTATION_PROB);
+    mutate(eliteChildren, config.mutationProb, focus, genomeRng);
     offsprings.insert(offsprings.end(), eliteChildren.begin(), eliteChildren.end());
-    int leftoverSize = POPULATION_SIZE * (1 - ELITE_PROPORTION*2);
+    // the rest of the population, however the elite proportion rounds
+    int leftoverSize = config.populationSize - 2 * config.numElite();
 
     vector<World> leftover(population.end() - leftoverSize, population.end());
 
-    mutate(leftover, MUTATION_PROB);
+    mutate(leftover, config.mutationProb, focus, genomeRng);
     offsprings.insert(offsprings.end(), leftover.begin(), leftover.end());
     for (World & o : offsprings) { 
-        o.cells = { {0, 0, INITIAL_ENERGY, 'n'} };
-        o.foods = getRandomizedFood();
+        o.cells = { {0, 0, config.initialEnergy, 'n'} };
+        o.foods = getRandomizedFood(config, rng);
     }
     return offsprings;
 }
 
+
 // ------------------- GENETIC ALGORITHM -------------------
 
-void runGeneticAlgorithm() {
+// One run of the genetic algorithm, driven a generation at a time: the
+// generation is begun, all its individuals are evaluated (from several
+// threads at once) and it is finished. The runs of a sweep are driven in
+// lockstep so that they share one thread pool.
+struct GeneticAlgorithm {
+    Config config;
+    bool verbose; // full log on cout, otherwise one line per generation
+
+    std::mt19937 rng;
+    FastRng genomeRng;
+
     vector<World> population;
-    generateInitialPopulation(population);
+    RuleArchiveWriter archive;
+
+    // state codes each individual of the current generation visited
+    vector<VisitedStates> visited;
+    VisitedStates mergedVisited;
+
+    Diversity diversity;
+    vector<int> tries;        // simulated per individual
+    uint32_t foodSeed = 0;    // of the food streams of this generation
+
+    // fitness of the last elite of the previous generation, individuals are
+    // raced against it (no racing in the first generation)
+    float eliteCutoff = -numeric_limits<float>::infinity();
+
+    int gen = 0;
 
     // For timing
     vector<chrono::duration<double>> gen_durations;
+    chrono::high_resolution_clock::time_point gen_start;
+
+    GeneticAlgorithm(const Config& runConfig, bool verboseLog)
+        : config(runConfig),
+          verbose(verboseLog),
+          rng(runConfig.seed ? runConfig.seed : std::random_device()()),
+          genomeRng((static_cast<uint64_t>(rng()) << 32) | rng()),
+          archive(createOutputDir(runConfig) + "/" + BEST_RULES_ARCHIVE),
+          visited(runConfig.populationSize),
+          tries(runConfig.populationSize) {
+        config.save(config.path("config.txt"));
+        generateInitialPopulation(population, config, rng, genomeRng);
+    }
+
+    static string createOutputDir(const Config& config) {
+        filesystem::create_directories(config.outputDir);
+        return config.outputDir;
+    }
+
+    bool done() const {
+        return gen >= config.numGenerations;
+    }
+
+    void beginGeneration() {
+        gen_start = std::chrono::high_resolution_clock::now();
+
+        if (verbose) {
+            cout << "Generation " << gen+1 << "/" << config.numGenerations << "\n";
+            cout << "-----------------------------------\n";
+        }
+
+        diversity = Diversity::of(population);
+        if (verbose) {
+            cout << "Diversity: mean " << diversity.meanDistance << ", min " << diversity.minDistance
+                 << ", distinct " << diversity.distinctGenomes << "/" << config.populationSize << endl;
+        }
+
+        // each individual draws its food layouts from its own stream, seeded
+        // from foodSeed and its index, so fitnesses do not depend on the
+        // number of threads or on which thread ran it
+        foodSeed = rng();
+    }
+
+    // ==== 1. Evaluate population (simulate + fitness) ====
+    // can be called for different individuals at once
+    void evaluate(int ind, Engines& engines) {
+        if (config.skipDuplicateGenomes && diversity.duplicateOf[ind] != ind) return;
+
+        std::seed_seq streamSeed{foodSeed, static_cast<uint32_t>(ind)};
+        std::mt19937 foodRng(streamSeed);
+
+        visited[ind].clear();
+        engines.recordVisits(&visited[ind]);
+        Evaluation evaluation = evaluateIndividual(population[ind], config, engines, foodRng, eliteCutoff);
+        population[ind].fitness = evaluation.fitness;
+        tries[ind] = evaluation.tries;
+    }
 
-    for (int gen = 0; gen < NUM_GENERATIONS; gen++) {
-        
-        auto gen_start = std::chrono::high_resolution_clock::now();
-
-        float averageFitness = 0.0f;
-
-        cout << "Generation " << gen+1 << "/" << NUM_GENERATIONS << "\n";
-        cout << "-----------------------------------\n";
-        
-        // ==== 1. Evaluate population (simulate + fitness) ====
-        for (int ind = 0; ind < POPULATION_SIZE; ind++) {
-            vector<float> fitnesses = {};
-            bool failedEarly = false;
-            for (int t = 0; t < NUM_TRIES; t++) {
-                World base = population[ind];   // keep rules/genome
-                base.cells.clear();
-                base.cells.push_back(Cell{0, 0, INITIAL_ENERGY, 'n'});
-                base.foods.clear();
-                vector<Food> newFoods = getRandomizedFood();
-                base.foods.insert(base.foods.end(), newFoods.begin(), newFoods.end());
-                World worldCopy = base;
-
-                // Run full simulation
-                for (int step = 0; step < NUM_STEPS; step++) {
-                    worldCopy = worldCopy.step();
-                }
-
-                // accumulate fitness over tries
-                float fitness = calculateFitness(worldCopy);
-                // early stopping if no positive fitness achieved
-                if (t >= 5 && gen > 0 && *std::max_element(fitnesses.begin(), fitnesses.begin() + t) <= averageFitness) {
-                    population[ind].fitness = -1;
-                    failedEarly = true;
-                    break;
-                } else {
-                    fitnesses.push_back(fitness);
-                }
+    void endGeneration() {
+        for (int ind = 0; ind < config.populationSize; ind++) {
+            int original = diversity.duplicateOf[ind];
+            if (config.skipDuplicateGenomes && original != ind) {
+                population[ind].fitness = population[original].fitness;
+                visited[ind] = visited[original];
+                tries[ind] = 0;
             }
-            if (failedEarly) continue;
-            // assign summed fitness
-            population[ind].fitness = accumulate(fitnesses.begin(), fitnesses.end(), 0.0f) / fitnesses.size();
         }
+        int totalTries = accumulate(tries.begin(), tries.end(), 0);
 
         // ==== 2. Sort and log ====
         sortByFitness(population);
 
-        cout << "Population sorted by fitness.\n";
-        for (size_t i = 0; i < population.size(); i++) {
-            cout << " " << population[i].fitness;
-            if (i < population.size() - 1) cout << ", ";
-        }
-        cout << "\nBest fitness: " << population[0].fitness << endl;
-        averageFitness = accumulate(population.begin(), population.end(), 0.0f,
+        float averageFitness = accumulate(population.begin(), population.end(), 0.0f,
                         [](float sum, const World& w) { return sum + w.fitness; })
                     / population.size();
-        cout << "Average fitness: " << averageFitness << endl;
 
-        saveBestRules(population, gen);
-        saveFitnessHistory(population, gen);
-        
+        mergedVisited.clear();
+        for (const VisitedStates& v : visited) mergedVisited.merge(v);
+
+        saveBestRules(archive, population, gen);
+        saveFitnessHistory(population, gen, config);
+        saveDiversity(diversity, gen, config);
+        saveRacing(totalTries, gen, config);
+        saveVisitedStates(visited, mergedVisited, gen, config);
+
+        if (verbose) {
+            cout << "Population sorted by fitness.\n";
+            for (size_t i = 0; i < population.size(); i++) {
+                cout << " " << population[i].fitness;
+                if (i < population.size() - 1) cout << ", ";
+            }
+            cout << "\nBest fitness: " << population[0].fitness << endl;
+            cout << "Average fitness: " << averageFitness << endl;
+            cout << "Tries: " << totalTries << "/" << config.populationSize * config.numTries
+                 << " (" << config.populationSize * config.numTries - totalTries << " saved)" << endl;
+            cout << "Visited states: " << mergedVisited.count() << "/" << STATE_SPACE << endl;
+        } else {
+            cout << config.outputDir << ": generation " << gen+1 << "/" << config.numGenerations
+                 << ", best " << population[0].fitness << ", average " << averageFitness << endl;
+        }
+
+        eliteCutoff = population[config.numElite() - 1].fitness;
+
         // ==== 4. Next generation ====
-        population = generateNextPopulation(population);
+        // the vector engine does not record visits, nothing to focus on
+        bool focus = config.focusOnVisited && config.engine != Engine::VECTOR;
+        if (verbose) cout << "Mutation probability: " << config.mutationProb << "\n";
+        population = generateNextPopulation(population, focus ? &mergedVisited : nullptr, config, rng, genomeRng);
 
         // ==== 5. Timing and ETA ====
         // Measure generation time
         auto gen_end = chrono::high_resolution_clock::now();
         gen_durations.push_back(gen_end - gen_start);
-        // cout << "Generation time: " << gen_durations.back().count() << " seconds.\n";
 
         // Estimate remaining time
-        if (gen > 0) {
+        if (verbose && gen > 0) {
             double avg_gen_time = std::accumulate(gen_durations.begin(), gen_durations.end(), 0.0, [](double sum, const auto& d) { return sum + d.count(); }) / gen_durations.size();
             cout << "Estimated time remaining: "
-                 << (NUM_GENERATIONS - gen - 1) * avg_gen_time / 60.0
+                 << (config.numGenerations - gen - 1) * avg_gen_time / 60.0
                  << " minutes\n";
         }
+        if (verbose) cout << "------------------------\n";
+
+        gen++;
+    }
+};
+
+// Runs the genetic algorithm once per configuration, all in lockstep on
+// one thread pool: every generation, the individuals of all runs still
+// going are evaluated as one batch of tasks. Uses the threads of the
+// first configuration.
+void runGeneticAlgorithms(const vector<Config>& configs) {
+    bool verbose = configs.size() == 1;
+
+    vector<unique_ptr<GeneticAlgorithm>> runs;
+    for (const Config& config : configs) {
+        runs.push_back(make_unique<GeneticAlgorithm>(config, verbose));
+    }
+
+    // evaluation threads, each with engine buffers shared by every
+    // simulation it runs
+    int threads = configs.front().threads > 0 ? configs.front().threads : max(1u, thread::hardware_concurrency());
+    ThreadPool evalPool(threads);
+    vector<Engines> workerEngines(evalPool.size());
+
+    vector<pair<GeneticAlgorithm*, int>> tasks;
+    while (true) {
+        tasks.clear();
+        for (auto& run : runs) {
+            if (run->done()) continue;
+            run->beginGeneration();
+            for (int ind = 0; ind < run->config.populationSize; ind++) tasks.emplace_back(run.get(), ind);
+        }
+        if (tasks.empty()) break;
+
+        // every worker takes the next individual left
+        atomic<int> next{0};
+        int numTasks = tasks.size();
+        evalPool.run(evalPool.size(), [&](int worker) {
+            for (int t = next++; t < numTasks; t = next++) {
+                tasks[t].first->evaluate(tasks[t].second, workerEngines[worker]);
+            }
+        });
 
-        cout << "------------------------\n";
+        for (auto& run : runs) {
+            if (!run->done()) run->endGeneration();
+        }
     }
 }
 
 // ------------------- MAIN -------------------
 
-int main() {
+// gen_alg [config file | key=value]...
+//
+// e.g. `gen_alg num_generations=200 energy_portion=0.1,0.2,0.3` runs three
+// configurations side by side into run_0, run_1 and run_2 (see loadConfigs)
+int main(int argc, char* argv[]) {
+
+    vector<Config> configs;
+    vector<string> labels;
+    try {
+        configs = loadConfigs(vector<string>(argv + 1, argv + argc), labels);
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
 
-    cout << "Number of generations: " << NUM_GENERATIONS << endl;
-    cout << "Population size: " << POPULATION_SIZE << endl;
-    cout << "Number of steps: " << NUM_STEPS << endl;
+    if (configs.size() == 1) {
+        const Config& config = configs.front();
+        cout << "Number of generations: " << config.numGenerations << endl;
+        cout << "Population size: " << config.populationSize << endl;
+        cout << "Number of steps: " << config.numSteps << endl;
+    } else {
+        cout << "Sweep of " << configs.size() << " configurations:" << endl;
+        for (size_t c = 0; c < configs.size(); c++) {
+            cout << configs[c].outputDir << ": " << labels[c] << endl;
+        }
+    }
     cout << "=======================================" << endl;
 
-    runGeneticAlgorithm();
-}
\ No newline at end of file
+    runGeneticAlgorithms(configs);
+    return 0;
+}
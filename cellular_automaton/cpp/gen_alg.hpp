@@ -1,22 +1,79 @@
+#pragma once
 #include <random>
 #include <vector>
+#include <numeric>
+#include <cmath>
+#include <algorithm>
 #include "physarum.hpp"
+#include "fitness_stats.hpp"
+#include "grid_world.hpp"
+#include "tiled_world.hpp"
+#include "batch_world.hpp"
+#include "genome_kernels.hpp"
+#include "config.hpp"
 
-const int NUM_GENERATIONS = 1000;
-const int POPULATION_SIZE  = 40;
-const int NUM_TRIES = 20;
+// ------------------- SIMULATION ENGINE -------------------
 
-const int NUM_STEPS = 100; 
+// threads a single world is stepped on by the grid engine
+int STEP_THREADS = 1;
 
-const float ELITE_PROPORTION = 0.15f;
-const float MUTATION_PROB = 0.3f;
+// buffers of the engines, reused by every simulation they run
+struct Engines {
+    GridWorld grid;
+    TiledWorld tiled;
+    BatchWorld batch;
 
-const float INITIAL_ENERGY = 100.0f;
+    ThreadPool stepPool;
 
-const int NUM_FOODS = 100;
-const float FOOD_ENERGY = 10.0f;
-const int MIN_FOOD_DIST = 0;
-const int MAX_FOOD_DIST = 20;
+    Engines() : stepPool(STEP_THREADS) {
+        grid.pool = &stepPool;
+    }
+
+    // makes every engine but the vector one mark the state codes it reads
+    // in visited (nullptr to stop)
+    void recordVisits(VisitedStates* visited) {
+        grid.visited = visited;
+        tiled.visited = visited;
+        batch.visited = visited;
+    }
+};
+
+// advances world by numSteps steps with engine and returns the fitness stats
+// of the final state; the grid engines read world.rules in place
+FitnessStats simulate(World& world, int numSteps, Engines& engines, Engine engine = ENGINE) {
+    if (engine == Engine::GRID) {
+        engines.grid.reset(world);
+        engines.grid.run(numSteps);
+        engines.grid.exportTo(world);
+        return engines.grid.stats;
+    }
+    if (engine == Engine::TILED) {
+        engines.tiled.reset(world);
+        for (int step = 0; step < numSteps; step++) {
+            engines.tiled.step();
+        }
+        engines.tiled.exportTo(world);
+        return FitnessStats::of(world);
+    }
+    if (engine == Engine::BATCH) {
+        engines.batch.clear();
+        engines.batch.addWorld(world.rules, world.params, world.cells, world.foods);
+        for (int step = 0; step < numSteps; step++) {
+            engines.batch.step();
+        }
+        engines.batch.exportTo(0, world);
+        return FitnessStats::of(world);
+    }
+    for (int step = 0; step < numSteps; step++) {
+        world = world.step();
+    }
+    return FitnessStats::of(world);
+}
+
+FitnessStats simulate(World& world, int numSteps) {
+    Engines engines;
+    return simulate(world, numSteps, engines);
+}
 
 // ------------------- RANDOM UTILITIES -------------------
 
@@ -41,18 +98,153 @@ int getRandomCoinFlip() {
     return dist(globalRng());
 }
 
-vector<Food> getRandomizedFood() {
-    std::uniform_int_distribution<int> dist(MIN_FOOD_DIST, MAX_FOOD_DIST);
+// food layout drawn from rng, so that threads with their own generator can
+// lay out food at the same time
+vector<Food> getRandomizedFood(const Config& config, std::mt19937& rng) {
+    std::uniform_int_distribution<int> dist(config.minFoodDist, config.maxFoodDist);
     std::bernoulli_distribution signDist(0.5);
     vector<Food> foods;
-    foods.reserve(NUM_FOODS);
-    for (int i = 0; i < NUM_FOODS; ++i) {
-        int dx = dist(globalRng());
-        int dy = dist(globalRng());
-        int sx = signDist(globalRng()) ? 1 : -1;
-        int sy = signDist(globalRng()) ? 1 : -1;
+    foods.reserve(config.numFoods);
+    for (int i = 0; i < config.numFoods; ++i) {
+        int dx = dist(rng);
+        int dy = dist(rng);
+        int sx = signDist(rng) ? 1 : -1;
+        int sy = signDist(rng) ? 1 : -1;
         if (dx == 0 && dy == 0) dy = 1; // avoid placing food at origin
-        foods.push_back(Food{ dx * sx, dy * sy, FOOD_ENERGY });
+        foods.push_back(Food{ dx * sx, dy * sy, config.foodEnergy });
     }
     return foods;
-}
\ No newline at end of file
+}
+
+vector<Food> getRandomizedFood() {
+    return getRandomizedFood(Config(), globalRng());
+}
+
+// ------------------- FITNESS -------------------
+
+float energyCentrality(const FitnessStats& stats) {
+    if (stats.cells == 0) return 0.0f;
+
+    float avgDist = stats.averageDistance();
+    return 1.0f / (avgDist + 1.0f);
+}
+
+float spread(const FitnessStats& stats) {
+    if (stats.cells == 0) return 0.0f;
+
+    float spread = std::round(static_cast<float>((stats.maxX - stats.minX) + (stats.maxY - stats.minY)) * 100.0f) / 100.0f;
+    return spread;
+}
+
+float totalCellsEnergy(World& world) {
+    float energy = 0;
+    for (const Cell& cell: world.cells) {
+        energy += cell.energy;
+    }
+    return energy;
+}
+
+float totalAcquiredEnergy(const FitnessStats& stats, const Config& config) {
+    float totalFoodEnergy = config.numFoods * config.foodEnergy;
+    return std::round((totalFoodEnergy - stats.foodEnergy) / totalFoodEnergy * 100.0f) / 100.0f;
+}
+
+float totalCells(const FitnessStats& stats) {
+    return static_cast<float>(stats.cells);
+}
+
+float droughtResistance(const FitnessStats& stats) {
+    return std::round(static_cast<float>(stats.lowEnergyCells) / static_cast<float>(stats.cells) * 100.0f) / 100.0f;
+}
+
+void sortByFitness(vector<World>& population) {
+    std::sort(population.begin(), population.end(),
+    [](const World& a, const World& b) {
+        return a.fitness > b.fitness;
+    });
+}
+
+float calculateFitness(const FitnessStats& stats, const Config& config) {
+    return 
+        totalAcquiredEnergy(stats, config)
+        + 0.01f * energyCentrality(stats)
+        + 0.03f * droughtResistance(stats);
+    // return spreadFitness(stats);
+    // return energyCentralityFitness(stats);
+}
+
+float calculateFitness(World& world, const Config& config) {
+    return calculateFitness(FitnessStats::of(world), config);
+}
+
+// ------------------- EVALUATION -------------------
+
+// runs all tries of one individual in lockstep with the batch engine and
+// returns the fitness of every try
+vector<float> evaluateTriesBatched(World& individual, const Config& config, BatchWorld& batch, std::mt19937& rng) {
+    batch.clear();
+    for (int t = 0; t < config.numTries; t++) {
+        batch.addWorld(individual.rules, config.world, {Cell{0, 0, config.initialEnergy, 'n'}}, getRandomizedFood(config, rng));
+    }
+    for (int step = 0; step < config.numSteps; step++) {
+        batch.step();
+    }
+
+    vector<float> fitnesses;
+    for (int t = 0; t < config.numTries; t++) {
+        batch.exportTo(t, individual);
+        fitnesses.push_back(calculateFitness(individual, config));
+    }
+    return fitnesses;
+}
+
+// upper confidence bound of the mean of fitnesses
+float upperFitnessBound(const vector<float>& fitnesses, float confidence) {
+    int n = fitnesses.size();
+    double mean = accumulate(fitnesses.begin(), fitnesses.end(), 0.0) / n;
+    double squares = 0;
+    for (float f : fitnesses) squares += (f - mean) * (f - mean);
+    double standardError = std::sqrt(squares / (n - 1) / n);
+    return mean + confidence * standardError;
+}
+
+struct Evaluation {
+    float fitness = 0; // average over the tries run
+    int tries = 0;     // tries simulated
+};
+
+// evaluates the individual on up to numTries food layouts drawn from rng,
+// racing it against eliteCutoff: it is dropped once the upper bound of its
+// fitness falls below the cut-off (see MIN_RACE_TRIES). The cut-off is last
+// generation's, so a dropped individual still ranks with the fitness of the
+// tries it ran and can end up in the elite. The batch engine runs all tries
+// at once, which leaves nothing to race for, so all of them count.
+Evaluation evaluateIndividual(World& individual, const Config& config, Engines& engines, std::mt19937& rng, float eliteCutoff) {
+    individual.params = config.world;
+    vector<float> fitnesses = {};
+    if (config.engine == Engine::BATCH) {
+        fitnesses = evaluateTriesBatched(individual, config, engines.batch, rng);
+    } else {
+        for (int t = 0; t < config.numTries; t++) {
+            // rules/genome are read in place
+            individual.cells.clear();
+            individual.cells.push_back(Cell{0, 0, config.initialEnergy, 'n'});
+            individual.foods = getRandomizedFood(config, rng);
+
+            // Run full simulation
+            FitnessStats stats = simulate(individual, config.numSteps, engines, config.engine);
+
+            // accumulate fitness over tries
+            fitnesses.push_back(calculateFitness(stats, config));
+
+            int tries = t + 1;
+            if (tries >= config.minRaceTries && tries < config.numTries
+                && upperFitnessBound(fitnesses, config.raceConfidence) < eliteCutoff) break;
+        }
+    }
+    // summed in try order, whichever thread ran the tries
+    Evaluation result;
+    result.fitness = accumulate(fitnesses.begin(), fitnesses.end(), 0.0f) / fitnesses.size();
+    result.tries = fitnesses.size();
+    return result;
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+using namespace std;
+
+// Bulk operations on whole rule tables, for initialising, recombining and
+// mutating genomes without a distribution object or a call per gene.
+
+// Counter-based generator (splitmix64). Output i only depends on the seed
+// and i, so bulk fills have no dependency chain between words and
+// vectorize.
+struct FastRng {
+    static constexpr uint64_t GOLDEN = 0x9E3779B97F4A7C15ull;
+
+    uint64_t state = 0;
+
+    explicit FastRng(uint64_t seed = 0) : state(seed) {}
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t next() {
+        state += GOLDEN;
+        return mix(state);
+    }
+
+    void fill(uint64_t* out, size_t n) {
+        uint64_t base = state;
+        for (size_t i = 0; i < n; i++) out[i] = mix(base + (i + 1) * GOLDEN);
+        state = base + n * GOLDEN;
+    }
+
+    // uniform in [0, 1)
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    // uniform in [0, bound), by multiply-shift
+    uint32_t below(uint32_t bound) {
+        return ((next() >> 32) * bound) >> 32;
+    }
+};
+
+// fills out[0, n) with actions uniform in [0, numActions), four per random
+// word (16 bits each, so the bias is below numActions / 65536)
+inline void fillRandomActions(uint8_t* out, size_t n, int numActions, FastRng& rng) {
+    const size_t CHUNK = 256;
+    uint64_t words[CHUNK];
+
+    for (size_t start = 0; start < n; start += CHUNK * 4) {
+        size_t count = min(CHUNK * 4, n - start);
+        rng.fill(words, (count + 3) / 4);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t lane = (words[i / 4] >> (16 * (i % 4))) & 0xFFFF;
+            out[start + i] = static_cast<uint8_t>((lane * numActions) >> 16);
+        }
+    }
+}
+
+// child[i] = a[i] or b[i] with probability 1/2 each, one random bit per gene
+inline void crossoverRules(const uint8_t* a, const uint8_t* b, uint8_t* child, size_t n, FastRng& rng) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t mask = rng.next();
+#ifdef __AVX2__
+        // every byte picks its bit of the mask and turns it into 0x00/0xFF
+        const __m256i spread = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i bits = _mm256_set1_epi64x(0x8040201008040201ll);
+        for (int half = 0; half < 2; half++) {
+            __m256i m = _mm256_set1_epi32(static_cast<uint32_t>(mask >> (32 * half)));
+            m = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(m, spread), bits), bits);
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32 * half));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32 * half));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(child + i + 32 * half), _mm256_blendv_epi8(vb, va, m));
+        }
+#else
+        for (int k = 0; k < 8; k++) {
+            // byte j of m is 0xFF if bit j of this mask byte is set
+            uint64_t bits = (mask >> (8 * k)) & 0xFF;
+            uint64_t picked = (bits * 0x0101010101010101ull) & 0x8040201008040201ull;
+            uint64_t m = ((((picked + 0x7F7F7F7F7F7F7F7Full) | picked) & 0x8080808080808080ull) >> 7) * 0xFF;
+
+            uint64_t wa, wb;
+            memcpy(&wa, a + i + 8 * k, 8);
+            memcpy(&wb, b + i + 8 * k, 8);
+            uint64_t wc = (wa & m) | (wb & ~m);
+            memcpy(child + i + 8 * k, &wc, 8);
+        }
+#endif
+    }
+    if (i < n) {
+        uint64_t mask = rng.next();
+        for (size_t k = 0; i + k < n; k++) child[i + k] = (mask >> k) & 1 ? a[i + k] : b[i + k];
+    }
+}
+
+// number of positions in [0, n) where a and b differ
+inline size_t hammingDistance(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t equal = 0;
+    size_t i = 0;
+#ifdef __AVX2__
+    // equal bytes are counted per lane in 8 bits (cmpeq gives -1), and
+    // summed into 64 bits before a lane can overflow
+    const __m256i zero = _mm256_setzero_si256();
+    while (i + 32 <= n) {
+        __m256i counts = zero;
+        for (int k = 0; k < 255 && i + 32 <= n; k++, i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(va, vb));
+        }
+        __m256i sums = _mm256_sad_epu8(counts, zero);
+        equal += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+               + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+#else
+    for (; i + 8 <= n; i += 8) {
+        // the high bit of a byte of zeros is set iff that byte of x is 0
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        uint64_t x = wa ^ wb;
+        uint64_t zeros = ~(((x & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | x | 0x7F7F7F7F7F7F7F7Full);
+        equal += ((zeros >> 7) * 0x0101010101010101ull) >> 56;
+    }
+#endif
+    for (; i < n; i++) equal += a[i] == b[i];
+    return n - equal;
+}
+
+// Calls mutate(i) for every i in [0, n) that is hit with probability p.
+// The gaps between hits are drawn from the geometric distribution, so the
+// cost is proportional to the number of hits, not to n.
+template <typename Mutate>
+void forEachMutation(size_t n, float p, FastRng& rng, Mutate&& mutate) {
+    if (p <= 0) return;
+    if (p >= 1) {
+        for (size_t i = 0; i < n; i++) mutate(i);
+        return;
+    }
+    const double logKeep = std::log1p(-static_cast<double>(p));
+    auto gap = [&]() {
+        return static_cast<size_t>(std::log1p(-rng.uniform()) / logKeep);
+    };
+    for (size_t i = gap(); i < n; i += 1 + gap()) mutate(i);
+}
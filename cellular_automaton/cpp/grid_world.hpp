@@ -0,0 +1,630 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <atomic>
+#include "physarum.hpp"
+#include "actions.hpp"
+#include "bit_planes.hpp"
+#include "thread_pool.hpp"
+#include "fitness_stats.hpp"
+#include "visited_states.hpp"
+using namespace std;
+
+// free slots kept around every cell and food so that growth targets and
+// their neighbors always fall inside the grid
+const int GRID_MARGIN = 2;
+
+// the four direct neighbors in the row-major order World keeps its cells in,
+// which is the order food, energy and signals are handed out in
+const int NEIGHBOR_OFFSETS[4][2] = {{0, -1}, {-1, 0}, {1, 0}, {0, 1}};
+
+// fewest rows a strip handed to another thread covers
+const int MIN_STRIP_ROWS = 16;
+
+// longest cycle of states run() looks for before fast-forwarding
+const int MAX_CYCLE_LENGTH = 4;
+
+// Grid-backed counterpart of World. Same cells/foods/rules state, but the
+// cells live in per-slot columns (occupancy, energy, energy direction,
+// memory) over a dense 2D grid indexed by coordinate.
+//
+// Every phase is a pair of branch-free row loops over the bounding box of
+// the colony: the first one records the direction each cell grows, passes
+// energy or signals in, the second one lets every slot gather what its four
+// neighbors aimed at it and writes the result into back-buffer columns.
+// Conflicts resolve the way World resolves them (strongest child wins,
+// energy sums in row-major order), without hashing or allocating per step.
+//
+// With a thread pool attached, each row loop is split into strips of rows
+// run in parallel. A slot only writes its own columns and the pool joins
+// between the two loops, which is where the one-slot halo of directions
+// around each strip gets exchanged, so the result does not depend on the
+// number of threads. Food and bookkeeping of new cells stay serial.
+//
+// Memory size, signal passes per step and the neighborhood read into state
+// codes are template parameters, so each variant compiles to its own kernel
+// with constant masks and unrolled signal passes.
+template <int MemorySize, int SignalsPerStep, Neighborhood Hood>
+struct BasicGridWorld {
+    static_assert(NEIGHBORHOOD_BITS + 2 * MemorySize <= 18, "state codes have to index the rule table");
+
+    static constexpr uint8_t MEMORY_MASK = (1 << (MemorySize * 2)) - 1;
+
+    // von Neumann variants ignore the diagonal neighbors (bits 8 to 11)
+    static constexpr uint16_t NEIGHBORHOOD_MASK = Hood == Neighborhood::MOORE ? 0x0FFF : 0x00FF;
+
+    vector<Food> foods;
+
+    // genome of the world being simulated, read in place and never copied
+    RuleView rules;
+    Params params;
+
+    // grid covers [originX, originX + width) x [originY, originY + height)
+    int originX = 0;
+    int originY = 0;
+    int width = 0;
+    int height = 0;
+
+    // cell columns, indexed by slot; empty slots hold 0 energy, 'n' and 0
+    // memory in both the front and the back buffers, so the phases can run
+    // over whole rows without checking occupancy first
+    vector<uint8_t> occupied;
+    vector<float> energy;
+    vector<char> energyDir;
+    vector<uint8_t> memory;
+    vector<int> foodCount; // number of foods with energy left in the slot
+
+    // slot of every cell, in the order the cells were added
+    vector<int> cellSlots;
+
+    // grid-local bounding box of the cells; it only grows between rebuilds,
+    // so everything a phase leaves outside of it is still empty
+    int minX = 0;
+    int maxX = -1;
+    int minY = 0;
+    int maxY = -1;
+
+    // back buffers the phases write into before they are swapped in; these
+    // and the scratch columns below keep their capacity across steps and
+    // resets, so stepping does not allocate once they are warm
+    vector<uint8_t> nextOccupied;
+    vector<float> nextEnergy;
+    vector<char> nextEnergyDir;
+    vector<uint8_t> nextMemory;
+
+    // state code and action of every cell, refreshed from the bit-planes
+    // per phase, and the direction each cell acts in during the current
+    // phase (DIR_NONE if it does not)
+    BitPlanes planes;
+    vector<uint16_t> stateCodes;
+    vector<uint8_t> actions;
+    vector<uint8_t> moves;
+
+    // slot distance of a step in every direction
+    int dirStep[5] = {0, 0, 0, 0, 0};
+
+    // fitness terms of the current state, kept up to date by the phases
+    FitnessStats stats;
+
+    // steps strips of rows in parallel when set; not owned
+    ThreadPool* pool = nullptr;
+
+    // every state code read from the rules is marked here when set; not owned
+    VisitedStates* visited = nullptr;
+
+    // state run() compares against to confirm a cycle
+    vector<float> savedEnergy;
+    vector<char> savedEnergyDir;
+    vector<uint8_t> savedMemory;
+    vector<float> savedFoods;
+    size_t savedCells = 0;
+
+    BasicGridWorld() = default;
+
+    explicit BasicGridWorld(const World& world) {
+        reset(world);
+    }
+
+    // loads the cells and foods of world and binds its rules, which have to
+    // stay alive and unchanged while this grid is stepped
+    void reset(const World& world) {
+        rules = world.rules.view();
+        params = world.params;
+        foods = world.foods;
+        rebuildGrid(world.cells);
+        stats = FitnessStats::of(world);
+    }
+
+    // writes the cells and foods back into world, leaving its rules alone
+    void exportTo(World& world) const {
+        world.cells = currentCells();
+        World::sortCells(world.cells);
+        world.foods = foods;
+    }
+
+    void step() {
+        if (cellSlots.empty()) return;
+        updateGrowth();
+        updateEnergy();
+        updateFood();
+        signalPasses(make_index_sequence<SignalsPerStep>{});
+        // the last signal pass counts low-energy cells on the way
+        if constexpr (SignalsPerStep == 0) countLowEnergyCells();
+    }
+
+    template <size_t... Pass>
+    void signalPasses(index_sequence<Pass...>) {
+        ((static_cast<void>(Pass), updateSignals()), ...);
+    }
+
+    // Same as calling step() numSteps times, but stops stepping once the
+    // world repeats itself. A step only depends on the current cells and
+    // foods, so once a state comes back after p steps it keeps cycling with
+    // period p (p = 1 being a fixed point) and the remaining steps can be
+    // skipped, except for (remaining % p) of them. Candidates are found by
+    // comparing state hashes with those of the last MAX_CYCLE_LENGTH steps
+    // and confirmed by running one more period against a saved copy, so the
+    // final state is exactly the one the plain loop ends in.
+    void run(int numSteps) {
+        // hashes of the last `recorded` states, by step
+        uint64_t recent[MAX_CYCLE_LENGTH + 1];
+        recent[0] = stateHash();
+        int recorded = 1;
+        int done = 0;
+
+        while (done < numSteps) {
+            step();
+            done++;
+
+            uint64_t hash = stateHash();
+            int period = 0;
+            for (int p = 1; p <= recorded && period == 0; p++) {
+                if (recent[(done - p) % (MAX_CYCLE_LENGTH + 1)] == hash) period = p;
+            }
+
+            if (period > 0 && numSteps - done >= period) {
+                saveState();
+                for (int i = 0; i < period; i++) step();
+                done += period;
+                if (matchesSavedState()) {
+                    for (int i = 0; i < (numSteps - done) % period; i++) step();
+                    return;
+                }
+                // hash collision, start over from here
+                recent[done % (MAX_CYCLE_LENGTH + 1)] = stateHash();
+                recorded = 1;
+                continue;
+            }
+
+            recent[done % (MAX_CYCLE_LENGTH + 1)] = hash;
+            recorded = min(recorded + 1, MAX_CYCLE_LENGTH);
+        }
+    }
+
+    // ------------------- GRID -------------------
+
+    int slotOf(int x, int y) const {
+        return (y - originY) * width + (x - originX);
+    }
+
+    // x and y are grid-local
+    bool hasMargin(int x, int y) const {
+        return x >= GRID_MARGIN && x + GRID_MARGIN < width
+            && y >= GRID_MARGIN && y + GRID_MARGIN < height;
+    }
+
+    vector<Cell> currentCells() const {
+        vector<Cell> cells;
+        cells.reserve(cellSlots.size());
+        for (int slot : cellSlots) {
+            cells.push_back(Cell{originX + slot % width, originY + slot / width,
+                                 energy[slot], energyDir[slot], memory[slot]});
+        }
+        return cells;
+    }
+
+    // fits the grid around cells and all foods (with slack to grow into)
+    // and lays every column out again
+    void rebuildGrid(const vector<Cell>& cells) {
+        int lowX = 0, highX = 0, lowY = 0, highY = 0;
+        bool first = true;
+        auto include = [&](int x, int y) {
+            if (first) { lowX = highX = x; lowY = highY = y; first = false; return; }
+            lowX = min(lowX, x); highX = max(highX, x);
+            lowY = min(lowY, y); highY = max(highY, y);
+        };
+        for (const Cell& cell : cells) include(cell.x, cell.y);
+        for (const Food& food : foods) include(food.x, food.y);
+
+        int slackX = max(GRID_MARGIN, (highX - lowX + 1) / 2);
+        int slackY = max(GRID_MARGIN, (highY - lowY + 1) / 2);
+        originX = lowX - slackX;
+        originY = lowY - slackY;
+        width = highX - lowX + 1 + 2 * slackX;
+        height = highY - lowY + 1 + 2 * slackY;
+
+        int slots = width * height;
+        occupied.assign(slots, 0);
+        energy.assign(slots, 0);
+        energyDir.assign(slots, 'n');
+        memory.assign(slots, 0);
+        foodCount.assign(slots, 0);
+        nextOccupied.assign(slots, 0);
+        nextEnergy.assign(slots, 0);
+        nextEnergyDir.assign(slots, 'n');
+        nextMemory.assign(slots, 0);
+        stateCodes.assign(slots, 0);
+        actions.assign(slots, 0);
+        moves.assign(slots, DIR_NONE);
+        planes.resize(width, height);
+
+        dirStep[DIR_LEFT] = -1;
+        dirStep[DIR_RIGHT] = 1;
+        dirStep[DIR_UP] = width;
+        dirStep[DIR_DOWN] = -width;
+
+        cellSlots.clear();
+        minX = minY = 0;
+        maxX = maxY = -1;
+        for (const Cell& cell : cells) addCell(slotOf(cell.x, cell.y));
+        for (const Cell& cell : cells) {
+            int slot = slotOf(cell.x, cell.y);
+            energy[slot] = nextEnergy[slot] = cell.energy;
+            energyDir[slot] = nextEnergyDir[slot] = cell.energyDir;
+            memory[slot] = nextMemory[slot] = cell.memory;
+        }
+        for (const Food& food : foods) {
+            if (food.energy > 0) foodCount[slotOf(food.x, food.y)]++;
+        }
+    }
+
+    // marks slot occupied in both buffers and grows the bounding box
+    void addCell(int slot) {
+        int x = slot % width;
+        int y = slot / width;
+        if (cellSlots.empty()) {
+            minX = maxX = x;
+            minY = maxY = y;
+        } else {
+            minX = min(minX, x); maxX = max(maxX, x);
+            minY = min(minY, y); maxY = max(maxY, y);
+        }
+        occupied[slot] = nextOccupied[slot] = 1;
+        cellSlots.push_back(slot);
+    }
+
+    // calls kernel(first, last) with the slot range [first, last) of every
+    // row of the bounding box, widened by pad slots on every side
+    template <typename Kernel>
+    void forEachRow(int pad, Kernel&& kernel) const {
+        int first = minX - pad;
+        int last = maxX + pad + 1;
+        forEachStrip(minY - pad, maxY + pad + 1, [&](int firstRow, int lastRow) {
+            for (int y = firstRow; y < lastRow; y++) {
+                kernel(y * width + first, y * width + last);
+            }
+        });
+    }
+
+    // calls strip(firstRow, lastRow) for consecutive strips covering rows
+    // [firstRow, lastRow), on the pool if there are enough rows to share
+    template <typename Strip>
+    void forEachStrip(int firstRow, int lastRow, Strip&& strip) const {
+        int rows = lastRow - firstRow;
+        int strips = pool ? min(pool->size(), rows / MIN_STRIP_ROWS) : 1;
+        if (strips <= 1) {
+            strip(firstRow, lastRow);
+            return;
+        }
+        pool->run(strips, [&](int i) {
+            strip(firstRow + rows * i / strips, firstRow + rows * (i + 1) / strips);
+        });
+    }
+
+    // ------------------- PHASES -------------------
+
+    void updateGrowth() {
+
+        computeActions();
+
+        const float minEnergy = params.minGrowthEnergy;
+        const uint8_t* occ = occupied.data();
+        const float* en = energy.data();
+        const int* food = foodCount.data();
+        const uint8_t* act = actions.data();
+        const int* step = dirStep;
+        uint8_t* mv = moves.data();
+
+        forEachRow(1, [&](int first, int last) {
+            for (int s = first; s < last; s++) {
+                Dir dir = occ[s] && !(en[s] < minEnergy) ? ACTION_TABLE[act[s]].growth : DIR_NONE;
+                // obstacles are checked against the cells from before this phase
+                int target = s + step[dir];
+                mv[s] = occ[target] || food[target] > 0 ? DIR_NONE : dir;
+            }
+        });
+
+        const int up = -width;
+        const int down = width;
+        uint8_t* nextOcc = nextOccupied.data();
+        float* nextEn = nextEnergy.data();
+
+        forEachRow(1, [&](int first, int last) {
+            for (int s = first; s < last; s++) {
+                // several cells growing into the same empty slot: the
+                // strongest wins
+                bool fromUp = mv[s + up] == DIR_UP;
+                bool fromLeft = mv[s - 1] == DIR_RIGHT;
+                bool fromRight = mv[s + 1] == DIR_LEFT;
+                bool fromDown = mv[s + down] == DIR_DOWN;
+
+                float child = 0;
+                child = fromUp && child < en[s + up] / 2 ? en[s + up] / 2 : child;
+                child = fromLeft && child < en[s - 1] / 2 ? en[s - 1] / 2 : child;
+                child = fromRight && child < en[s + 1] / 2 ? en[s + 1] / 2 : child;
+                child = fromDown && child < en[s + down] / 2 ? en[s + down] / 2 : child;
+
+                bool born = fromUp || fromLeft || fromRight || fromDown;
+                nextOcc[s] = occ[s] | born;
+                nextEn[s] = mv[s] != DIR_NONE ? en[s] / 2 : (born ? child : en[s]);
+            }
+        });
+
+        // children start with 'n' and empty memory, which their slots hold
+        // already, so only the new slots have to be recorded
+        bool outgrown = false;
+        size_t parents = cellSlots.size();
+        for (size_t i = 0; i < parents; i++) {
+            int s = cellSlots[i];
+            if (mv[s] == DIR_NONE) continue;
+            int target = s + step[mv[s]];
+            if (occupied[target]) continue; // already added for another parent
+            addCell(target);
+            stats.addCell(originX + target % width, originY + target / width);
+            if (!hasMargin(target % width, target / width)) outgrown = true;
+        }
+
+        swap(occupied, nextOccupied);
+        swap(energy, nextEnergy);
+
+        if (outgrown) rebuildGrid(currentCells());
+    }
+
+    void updateEnergy() {
+
+        computeActions();
+
+        const float minEnergy = params.minEnergyToPassEnergy;
+        const float portionOf = params.energyPortion;
+        const float keptOf = 1 - params.energyPortion;
+        const uint8_t* occ = occupied.data();
+        const float* en = energy.data();
+        const char* dirs = energyDir.data();
+        const uint8_t* mem = memory.data();
+        const uint8_t* act = actions.data();
+        const int* step = dirStep;
+        uint8_t* mv = moves.data();
+
+        // energy is only passed to an existing cell
+        forEachRow(1, [&](int first, int last) {
+            for (int s = first; s < last; s++) {
+                Dir dir = occ[s] && !(en[s] * portionOf < minEnergy) ? ACTION_TABLE[act[s]].energy : DIR_NONE;
+                mv[s] = occ[s + step[dir]] ? dir : DIR_NONE;
+            }
+        });
+
+        const int up = -width;
+        const int down = width;
+        float* nextEn = nextEnergy.data();
+        char* nextDirs = nextEnergyDir.data();
+        uint8_t* nextMem = nextMemory.data();
+
+        // a cell that received energy sums its own entry with every portion
+        // sent to it and is reset, same as World::resolveEnergyConflicts;
+        // the sum runs in row-major order of the contributing entries, and
+        // adding 0 for a missing one leaves it unchanged
+        forEachRow(0, [&](int first, int last) {
+            for (int s = first; s < last; s++) {
+                bool fromUp = mv[s + up] == DIR_UP;
+                bool fromLeft = mv[s - 1] == DIR_RIGHT;
+                bool fromRight = mv[s + 1] == DIR_LEFT;
+                bool fromDown = mv[s + down] == DIR_DOWN;
+                bool received = fromUp || fromLeft || fromRight || fromDown;
+
+                bool sends = mv[s] != DIR_NONE;
+                float own = sends ? en[s] * keptOf : en[s];
+                float portion = en[s] * portionOf;
+
+                float sum = 0;
+                sum += fromUp ? portion : 0.0f;
+                sum += fromLeft ? portion : 0.0f;
+                sum += own;
+                sum += fromRight ? portion : 0.0f;
+                sum += fromDown ? portion : 0.0f;
+
+                nextEn[s] = received ? sum : own;
+                nextDirs[s] = received ? 'n' : (sends ? DIR_CHARS[mv[s]] : dirs[s]);
+                nextMem[s] = received ? 0 : mem[s];
+            }
+        });
+
+        swap(energy, nextEnergy);
+        swap(energyDir, nextEnergyDir);
+        swap(memory, nextMemory);
+    }
+
+    void updateFood() {
+
+        for (Food & food : foods) {
+            if (food.energy <= 0) continue;
+            for (const auto & offset : NEIGHBOR_OFFSETS) {
+                int slot = slotOf(food.x + offset[0], food.y + offset[1]);
+                if (!occupied[slot]) continue;
+
+                food.energy -= 1;
+                energy[slot] += 1;
+                stats.foodEnergy -= 1;
+                if (food.energy <= 0) break;
+            }
+            if (food.energy <= 0) {
+                foodCount[slotOf(food.x, food.y)]--;
+                stats.foodEnergy -= food.energy; // gone with the food
+            }
+        }
+
+        // remove depleted foods
+        foods.erase(remove_if(foods.begin(), foods.end(),
+            [](const Food & f) { return f.energy <= 0; }),
+            foods.end());
+    }
+
+    void updateSignals() {
+
+        computeActions();
+
+        const float minEnergy = params.minEnergyToSignal;
+        const float cost = params.signalCost;
+        const uint8_t* occ = occupied.data();
+        const float* en = energy.data();
+        const uint8_t* mem = memory.data();
+        const uint8_t* act = actions.data();
+        const int* step = dirStep;
+        uint8_t* mv = moves.data();
+
+        // a signal is only sent to an existing cell
+        forEachRow(1, [&](int first, int last) {
+            for (int s = first; s < last; s++) {
+                Dir dir = occ[s] && !(en[s] < minEnergy) ? ACTION_TABLE[act[s]].signal : DIR_NONE;
+                mv[s] = occ[s + step[dir]] ? dir : DIR_NONE;
+            }
+        });
+
+        const int up = -width;
+        const int down = width;
+        float* nextEn = nextEnergy.data();
+        uint8_t* nextMem = nextMemory.data();
+        const float lowEnergy = params.minGrowthEnergy;
+        atomic<int> lowCells{0};
+
+        // receivers shift in the signals of their neighbors in row-major order
+        forEachRow(0, [&](int first, int last) {
+            int low = 0;
+            for (int s = first; s < last; s++) {
+                nextEn[s] = mv[s] != DIR_NONE ? en[s] - cost : en[s];
+                low += occ[s] & (nextEn[s] < lowEnergy);
+
+                uint8_t m = mem[s];
+                m = mv[s + up] == DIR_UP ? ((m << 2) | SIGNAL_VALUES[DIR_UP]) & MEMORY_MASK : m;
+                m = mv[s - 1] == DIR_RIGHT ? ((m << 2) | SIGNAL_VALUES[DIR_RIGHT]) & MEMORY_MASK : m;
+                m = mv[s + 1] == DIR_LEFT ? ((m << 2) | SIGNAL_VALUES[DIR_LEFT]) & MEMORY_MASK : m;
+                m = mv[s + down] == DIR_DOWN ? ((m << 2) | SIGNAL_VALUES[DIR_DOWN]) & MEMORY_MASK : m;
+                nextMem[s] = m;
+            }
+            lowCells += low;
+        });
+
+        swap(energy, nextEnergy);
+        swap(memory, nextMemory);
+        stats.lowEnergyCells = lowCells;
+    }
+
+    void countLowEnergyCells() {
+        stats.lowEnergyCells = 0;
+        for (int slot : cellSlots) {
+            if (energy[slot] < params.minGrowthEnergy) stats.lowEnergyCells++;
+        }
+    }
+
+    // ------------------- STEADY STATE -------------------
+
+    // hash of everything a step depends on; cellSlots only ever grows
+    // until the grid is rebuilt, so it is part of the state as well
+    uint64_t stateHash() const {
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        auto mix = [&](uint64_t value) {
+            hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+        };
+        auto floatBits = [](float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        };
+
+        mix(static_cast<uint32_t>(originX));
+        mix(static_cast<uint32_t>(originY));
+        mix(cellSlots.size());
+        for (int slot : cellSlots) {
+            mix((uint64_t(floatBits(energy[slot])) << 32) | (uint64_t(uint8_t(energyDir[slot])) << 8) | memory[slot]);
+        }
+        mix(foods.size());
+        for (const Food & food : foods) mix(floatBits(food.energy));
+        return hash;
+    }
+
+    void saveState() {
+        savedCells = cellSlots.size();
+        savedEnergy.clear();
+        savedEnergyDir.clear();
+        savedMemory.clear();
+        for (int slot : cellSlots) {
+            savedEnergy.push_back(energy[slot]);
+            savedEnergyDir.push_back(energyDir[slot]);
+            savedMemory.push_back(memory[slot]);
+        }
+        savedFoods.clear();
+        for (const Food & food : foods) savedFoods.push_back(food.energy);
+    }
+
+    // compared bit for bit; no new cells means no rebuild, so the slots
+    // still are the saved ones
+    bool matchesSavedState() const {
+        if (cellSlots.size() != savedCells || foods.size() != savedFoods.size()) return false;
+        for (size_t i = 0; i < cellSlots.size(); i++) {
+            int slot = cellSlots[i];
+            if (memcmp(&energy[slot], &savedEnergy[i], sizeof(float)) != 0
+                || energyDir[slot] != savedEnergyDir[i]
+                || memory[slot] != savedMemory[i]) return false;
+        }
+        for (size_t i = 0; i < foods.size(); i++) {
+            if (memcmp(&foods[i].energy, &savedFoods[i], sizeof(float)) != 0) return false;
+        }
+        return true;
+    }
+
+    // ------------------- RULES -------------------
+
+    uint8_t getNextAction(uint16_t stateCode) const {
+        return rules[stateCode];
+    }
+
+    // fills stateCodes and actions for every cell from freshly built
+    // bit-planes; empty slots keep action 0, which does nothing
+    void computeActions() {
+        planes.clear();
+        forEachStrip(minY, maxY + 1, [&](int firstRow, int lastRow) {
+            for (int y = firstRow; y < lastRow; y++) {
+                for (int x = minX; x <= maxX; x++) {
+                    int slot = y * width + x;
+                    if (occupied[slot]) planes.setCell(x, y, energyDir[slot]);
+                }
+            }
+        });
+
+        auto visit = [&](int x, int y, uint16_t neighborhood) {
+            int slot = y * width + x;
+            uint16_t code = (neighborhood & NEIGHBORHOOD_MASK)
+                | (static_cast<uint16_t>(memory[slot] & MEMORY_MASK) << NEIGHBORHOOD_BITS);
+            stateCodes[slot] = code;
+            actions[slot] = getNextAction(code);
+            if (visited) visited->mark(code);
+        };
+        forEachStrip(minY, maxY + 1, [&](int firstRow, int lastRow) {
+            planes.forEachStateCode(visit, firstRow, lastRow);
+        });
+    }
+};
+
+using GridWorld = BasicGridWorld<MEMORY_SIZE, SIGNALS_PER_STEP, Neighborhood::MOORE>;
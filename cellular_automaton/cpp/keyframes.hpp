@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "gen_alg.hpp"
+using namespace std;
+
+// Snapshots of one run taken every `interval` steps by a background thread
+// that simulates ahead of whoever is watching. seek() restores the closest
+// keyframe at or before the wanted step and simulates at most interval - 1
+// steps from there, so jumping around a long run stays cheap. Keyframes only
+// hold cells and foods; the rules and params are kept once for the whole run.
+struct Keyframes {
+    struct Keyframe {
+        vector<Cell> cells;
+        vector<Food> foods;
+    };
+
+    RuleTable rules;
+    Params params;
+    int interval = 1;
+    int numSteps = 0;
+
+    // frames[k] is the state after k * interval steps
+    vector<Keyframe> frames;
+    mutex lock;
+
+    thread recorder;
+    atomic<bool> stopping{false};
+
+    Keyframes() = default;
+
+    Keyframes(const Keyframes&) = delete;
+    Keyframes& operator=(const Keyframes&) = delete;
+
+    ~Keyframes() {
+        stop();
+    }
+
+    // forgets the previous run and starts recording world from step 0
+    void start(const World& world, int keyframeInterval, int steps) {
+        stop();
+
+        rules = world.rules;
+        params = world.params;
+        interval = keyframeInterval;
+        numSteps = steps;
+        frames.assign(1, Keyframe{world.cells, world.foods});
+
+        stopping = false;
+        recorder = thread([this, world] { record(world); });
+    }
+
+    void stop() {
+        stopping = true;
+        if (recorder.joinable()) recorder.join();
+    }
+
+    void record(World world) {
+        Engines engines;
+        for (int done = interval; done <= numSteps && !stopping; done += interval) {
+            simulate(world, interval, engines);
+            lock_guard<mutex> guard(lock);
+            frames.push_back(Keyframe{world.cells, world.foods});
+        }
+    }
+
+    // number of steps covered by keyframes so far
+    int recordedSteps() {
+        lock_guard<mutex> guard(lock);
+        return (frames.size() - 1) * interval;
+    }
+
+    // state of the run after `step` steps
+    World seek(int step, Engines& engines) {
+        World world;
+        int from;
+        {
+            lock_guard<mutex> guard(lock);
+            int k = min<int>(step / interval, frames.size() - 1);
+            world.cells = frames[k].cells;
+            world.foods = frames[k].foods;
+            from = k * interval;
+        }
+        world.rules = rules;
+        world.params = params;
+        simulate(world, step - from, engines);
+        return world;
+    }
+};
@@ -1,3 +1,4 @@
+#pragma once
 #include <optional>
 #include <cstdint>
 #include <vector>
@@ -6,6 +7,7 @@
 #include <algorithm>
 #include <utility>
 #include <iostream>
+#include "rule_table.hpp"
 using namespace std;
 
 namespace std {
@@ -19,11 +21,12 @@ namespace std {
 
 vector<char> dirs = {'n', 'l', 'r', 'u', 'd'};
 
-float MIN_GROWTH_ENERGY = 10;
-float ENERGY_PORTION = 0.2;
-float MIN_ENERGY_TO_PASS_ENERGY = 0.5;
-float MIN_ENERGY_TO_SIGNAL = 0.2;
-float SIGNAL_COST = 0.01;
+// defaults of the tuning knobs in Params
+const float MIN_GROWTH_ENERGY = 10;
+const float ENERGY_PORTION = 0.2;
+const float MIN_ENERGY_TO_PASS_ENERGY = 0.5;
+const float MIN_ENERGY_TO_SIGNAL = 0.2;
+const float SIGNAL_COST = 0.01;
 
 const int MEMORY_SIZE = 2;
 
@@ -48,12 +51,23 @@ struct Food {
     float energy;
 };
 
+// Tuning knobs of the automaton. Every world carries its own, so worlds
+// with different settings can be simulated side by side.
+struct Params {
+    float minGrowthEnergy = MIN_GROWTH_ENERGY;
+    float energyPortion = ENERGY_PORTION;
+    float minEnergyToPassEnergy = MIN_ENERGY_TO_PASS_ENERGY;
+    float minEnergyToSignal = MIN_ENERGY_TO_SIGNAL;
+    float signalCost = SIGNAL_COST;
+};
+
 
 struct World {
     vector<Cell> cells;
     vector<Food> foods;
 
-    vector<uint8_t> rules;
+    RuleTable rules;
+    Params params;
 
     float fitness = 0;
 
@@ -72,6 +86,7 @@ struct World {
 
         World newWorld;
         newWorld.rules = rules;
+        newWorld.params = params;
         newWorld.foods = foods;
 
         for (Cell & cell : cells) {
@@ -89,7 +104,7 @@ struct World {
             else if (growthDir == 'u') targetY += 1;
             else if (growthDir == 'd') targetY -= 1;
 
-            if (growthDir == 'n' || cell.energy < MIN_GROWTH_ENERGY || anyObstaclesAt(targetX, targetY)) {
+            if (growthDir == 'n' || cell.energy < params.minGrowthEnergy || anyObstaclesAt(targetX, targetY)) {
                 Cell updatedOrigCell = cell;
                 newWorld.cells.push_back(updatedOrigCell);
                 continue;
@@ -144,6 +159,7 @@ struct World {
             newCells.push_back(strongest);
         }
 
+        sortCells(newCells);
         return newCells;
     }
 
@@ -151,6 +167,7 @@ struct World {
 
         World newWorld;
         newWorld.rules = rules;
+        newWorld.params = params;
         newWorld.foods = foods;
         
         for (Cell & cell : cells) {
@@ -161,7 +178,7 @@ struct World {
             char energyDir = decodeEnergyDir(action);
 
             // no energy passed
-            if (energyDir == 'n' || cell.energy * ENERGY_PORTION < MIN_ENERGY_TO_PASS_ENERGY) {
+            if (energyDir == 'n' || cell.energy * params.energyPortion < params.minEnergyToPassEnergy) {
                 Cell newCell = cell;
                 newWorld.cells.push_back(newCell);
                 continue;
@@ -185,10 +202,10 @@ struct World {
             }
 
             Cell updatedOrigCell = cell;
-            updatedOrigCell.energy *= (1 - ENERGY_PORTION);
+            updatedOrigCell.energy *= (1 - params.energyPortion);
             updatedOrigCell.energyDir = energyDir;
             newWorld.cells.push_back(updatedOrigCell);
-            newWorld.cells.push_back(Cell{targetX, targetY, targetCell->energy * ENERGY_PORTION, 'n'});
+            newWorld.cells.push_back(Cell{targetX, targetY, targetCell->energy * params.energyPortion, 'n'});
         }
 
         newWorld.cells = resolveEnergyConflicts(newWorld.cells);
@@ -222,6 +239,7 @@ struct World {
             newCells.push_back(Cell{el.first.first, el.first.second, newEnergy, 'n'});
         }
 
+        sortCells(newCells);
         return newCells;
     }
 
@@ -229,6 +247,7 @@ struct World {
 
         World newWorld;
         newWorld.rules = rules;
+        newWorld.params = params;
         newWorld.cells = cells;
         newWorld.foods = foods;
 
@@ -269,6 +288,7 @@ struct World {
 
         World newWorld;
         newWorld.rules = rules;
+        newWorld.params = params;
         newWorld.foods = foods;
 
         unordered_map<pair<int,int>, Cell, pair_hash> newCellsMap;
@@ -283,7 +303,7 @@ struct World {
             uint8_t action = getNextAction(state);
             char signalDir = decodeSignalDir(action);
 
-            if (signalDir == 'n' || cell.energy < MIN_ENERGY_TO_SIGNAL) continue;
+            if (signalDir == 'n' || cell.energy < params.minEnergyToSignal) continue;
 
             int targetX = cell.x, targetY = cell.y;
             int val = -1;
@@ -296,30 +316,39 @@ struct World {
             if (it == newCellsMap.end()) continue; // no target
 
             // Update sender
-            newCellsMap[{cell.x, cell.y}].energy -= SIGNAL_COST;
+            newCellsMap[{cell.x, cell.y}].energy -= params.signalCost;
 
-            std::cout << "----" << endl;
             // Update receiver memory safely
             uint8_t &mem = it->second.memory;
             mem = ((mem << 2) | val) & ((1 << (MEMORY_SIZE*2)) - 1);
-            cout << mem << endl;
         }
 
         // Move map into vector
         for (auto &[pos, cell] : newCellsMap) {
             newWorld.cells.push_back(cell);
         }
+        sortCells(newWorld.cells);
 
         return newWorld;
     }
 
 
+    // keeps cells in row-major order (ascending y, then x) so that the order
+    // food and signals are handed out in does not depend on the hash map
+    static void sortCells(vector<Cell>& cells) {
+        std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+            return a.y < b.y || (a.y == b.y && a.x < b.x);
+        });
+    }
+
     uint8_t getNextAction(uint16_t stateCode) {
 
         return rules[stateCode];
     }
 
     char decodeGrowthDir(uint8_t actionCode) {
+        // codes from 25 on point past the end of dirs and mean no growth
+        if (actionCode / 5 >= static_cast<int>(dirs.size())) return 'n';
         return dirs[actionCode / 5];
     }
 
@@ -0,0 +1,263 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "physarum.hpp"
+#include "rule_table.hpp"
+using namespace std;
+
+// Append-only archive of the best rules of every generation, replacing the
+// text dump in best_individual.csv. It is made of two files:
+//
+//   <path>.bin   header, then one record per saved generation
+//   <path>.idx   header, then one fixed-size IndexEntry per record
+//
+// A record is either the full rule table or a delta against the last full
+// record (its base): a gene count followed by (varint gap to the previous
+// changed gene, new value) pairs. Successive bests share most of their
+// genes, so deltas are small; once a delta would hold more than
+// MAX_DELTA_GENES genes a full record is written and becomes the new base.
+// Loading a generation therefore reads at most two records, whatever the
+// length of the run. Everything is stored little-endian, as laid out in
+// memory on the machines this runs on.
+
+const char RULE_ARCHIVE_MAGIC[8] = {'C', 'A', 'R', 'U', 'L', 'E', 'S', '1'};
+const char RULE_INDEX_MAGIC[8] = {'C', 'A', 'R', 'I', 'D', 'X', '0', '1'};
+
+const int MAX_DELTA_GENES = STATE_SPACE / 16;
+
+// archive the genetic algorithm writes and the animator reads
+const string BEST_RULES_ARCHIVE = "best_rules";
+
+enum RecordKind : uint32_t { RECORD_FULL, RECORD_DELTA };
+
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t stateSpace;
+    uint32_t reserved;
+};
+
+struct IndexEntry {
+    int32_t generation;
+    uint32_t kind;
+    uint64_t offset;     // of the record in the .bin file
+    uint64_t baseOffset; // of the full record a delta applies to
+};
+
+// read-only view of a whole file
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+
+        data = static_cast<const uint8_t*>(mapped);
+        size = info.st_size;
+        return true;
+    }
+
+    void close() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+};
+
+// ------------------- READER -------------------
+
+struct RuleArchive {
+    MappedFile records;
+    MappedFile index;
+
+    bool open(const string& path) {
+        if (!records.open(path + ".bin") || !index.open(path + ".idx")) return false;
+        return validHeader(records, RULE_ARCHIVE_MAGIC) && validHeader(index, RULE_INDEX_MAGIC);
+    }
+
+    static bool validHeader(const MappedFile& file, const char* magic) {
+        if (file.size < sizeof(ArchiveHeader)) return false;
+        ArchiveHeader header;
+        memcpy(&header, file.data, sizeof(header));
+        return memcmp(header.magic, magic, 8) == 0 && header.stateSpace == STATE_SPACE;
+    }
+
+    // number of saved generations; a partly written last entry is ignored
+    int size() const {
+        if (!index.data) return 0;
+        return (index.size - sizeof(ArchiveHeader)) / sizeof(IndexEntry);
+    }
+
+    IndexEntry entry(int i) const {
+        IndexEntry e;
+        memcpy(&e, index.data + sizeof(ArchiveHeader) + i * sizeof(IndexEntry), sizeof(e));
+        return e;
+    }
+
+    // entry of the first record saved for generation, or -1. Generations
+    // of a run are saved in order from 0, so entry `generation` is checked
+    // first; later runs appended to the same archive fall back to a scan.
+    int find(int generation) const {
+        int n = size();
+        if (generation >= 0 && generation < n && entry(generation).generation == generation) {
+            return generation;
+        }
+        for (int i = 0; i < n; i++) {
+            if (entry(i).generation == generation) return i;
+        }
+        return -1;
+    }
+
+    // rules of entry i
+    void load(int i, vector<uint8_t>& rules) const {
+        IndexEntry e = entry(i);
+        rules.resize(STATE_SPACE);
+        memcpy(rules.data(), records.data + e.baseOffset, STATE_SPACE);
+        if (e.kind == RECORD_FULL) return;
+
+        const uint8_t* p = records.data + e.offset;
+        uint32_t count;
+        memcpy(&count, p, sizeof(count));
+        p += sizeof(count);
+
+        uint32_t gene = 0;
+        for (uint32_t k = 0; k < count; k++) {
+            uint32_t gap = 0;
+            for (int shift = 0; ; shift += 7) {
+                uint8_t byte = *p++;
+                gap |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            gene += gap;
+            rules[gene] = *p++;
+        }
+    }
+};
+
+// ------------------- WRITER -------------------
+
+struct RuleArchiveWriter {
+    string path;
+    ofstream records;
+    ofstream index;
+    uint64_t recordsSize = 0;
+
+    // last full record, deltas are taken against it; pages the saved rules
+    // still share with it are skipped without comparing
+    RuleTable base;
+    uint64_t baseOffset = 0;
+
+    vector<uint8_t> scratch;
+
+    // continues an existing archive at path (without extension), unless
+    // append is false, or starts a new one
+    explicit RuleArchiveWriter(const string& archivePath, bool append = true) : path(archivePath) {
+        RuleArchive existing;
+        bool resume = append && existing.open(path) && existing.size() > 0;
+        if (resume) {
+            IndexEntry last = existing.entry(existing.size() - 1);
+            const uint8_t* saved = existing.records.data + last.baseOffset;
+            base = RuleTable(vector<uint8_t>(saved, saved + STATE_SPACE));
+            baseOffset = last.baseOffset;
+            recordsSize = existing.records.size;
+            // drops a partly written index entry, so that entries stay aligned
+            truncate((path + ".idx").c_str(), sizeof(ArchiveHeader) + existing.size() * sizeof(IndexEntry));
+        }
+
+        records.open(path + ".bin", resume ? ios::binary | ios::app : ios::binary | ios::trunc);
+        index.open(path + ".idx", resume ? ios::binary | ios::app : ios::binary | ios::trunc);
+        if (!records || !index) throw runtime_error("Could not open rule archive " + path);
+
+        if (!resume) {
+            writeHeader(records, RULE_ARCHIVE_MAGIC);
+            writeHeader(index, RULE_INDEX_MAGIC);
+            recordsSize = sizeof(ArchiveHeader);
+        }
+    }
+
+    static void writeHeader(ofstream& file, const char* magic) {
+        ArchiveHeader header{};
+        memcpy(header.magic, magic, 8);
+        header.stateSpace = STATE_SPACE;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    void append(int generation, const RuleTable& rules) {
+        IndexEntry e{generation, RECORD_FULL, recordsSize, recordsSize};
+
+        if (!base.empty() && encodeDelta(rules)) {
+            e.kind = RECORD_DELTA;
+            e.baseOffset = baseOffset;
+            records.write(reinterpret_cast<const char*>(scratch.data()), scratch.size());
+            recordsSize += scratch.size();
+        } else {
+            base = rules;
+            baseOffset = recordsSize;
+            for (int p = 0; p < rules.numPages(); p++) {
+                records.write(reinterpret_cast<const char*>(rules.page(p)), RULE_PAGE_SIZE);
+            }
+            recordsSize += STATE_SPACE;
+        }
+
+        // the record has to be complete before the index points at it
+        records.flush();
+        index.write(reinterpret_cast<const char*>(&e), sizeof(e));
+        index.flush();
+    }
+
+    // encodes rules against base into scratch; false if too many genes differ
+    bool encodeDelta(const RuleTable& rules) {
+        scratch.assign(sizeof(uint32_t), 0);
+        uint32_t count = 0;
+        uint32_t previous = 0;
+
+        for (int p = 0; p < rules.numPages(); p++) {
+            if (rules.sharesPage(base, p)) continue;
+
+            const uint8_t* page = rules.page(p);
+            const uint8_t* basePage = base.page(p);
+            for (uint32_t k = 0; k < RULE_PAGE_SIZE; k++) {
+                if (page[k] == basePage[k]) continue;
+                if (++count > MAX_DELTA_GENES) return false;
+
+                uint32_t gene = p * RULE_PAGE_SIZE + k;
+                uint32_t gap = gene - previous;
+                previous = gene;
+                while (gap >= 0x80) {
+                    scratch.push_back(static_cast<uint8_t>(gap) | 0x80);
+                    gap >>= 7;
+                }
+                scratch.push_back(static_cast<uint8_t>(gap));
+                scratch.push_back(page[k]);
+            }
+        }
+        memcpy(scratch.data(), &count, sizeof(count));
+        return true;
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+const int RULE_PAGE_BITS = 12;
+const int RULE_PAGE_SIZE = 1 << RULE_PAGE_BITS;
+const int RULE_PAGE_MASK = RULE_PAGE_SIZE - 1;
+
+// What the engines read rules through: one data pointer per page.
+struct RuleView {
+    const uint8_t* const* pages = nullptr;
+
+    uint8_t operator[](uint32_t code) const {
+        return pages[code >> RULE_PAGE_BITS][code & RULE_PAGE_MASK];
+    }
+};
+
+// Rule table (genome) split into pages that copies share. Copying a table
+// only copies its page pointers; a page is cloned the first time a table
+// that shares it writes into it. Genomes derived from each other only pay
+// memory and copy bandwidth for the pages they changed. Tables hold whole
+// pages, and are not meant to be written from several threads at once.
+struct RuleTable {
+    using Page = array<uint8_t, RULE_PAGE_SIZE>;
+
+    vector<shared_ptr<Page>> pages;
+    vector<const uint8_t*> pageData; // pages[p]->data(), for RuleView
+
+    RuleTable() = default;
+
+    explicit RuleTable(size_t size, uint8_t value = 0) {
+        pages.resize(size / RULE_PAGE_SIZE);
+        pageData.resize(pages.size());
+        for (int p = 0; p < numPages(); p++) {
+            newPage(p);
+            pages[p]->fill(value);
+        }
+    }
+
+    explicit RuleTable(const vector<uint8_t>& rules) : RuleTable(rules.size()) {
+        for (int p = 0; p < numPages(); p++) {
+            memcpy(pages[p]->data(), rules.data() + p * RULE_PAGE_SIZE, RULE_PAGE_SIZE);
+        }
+    }
+
+    // table whose pages are the consecutive pages of block, which it keeps
+    // alive; writing into block changes the table in place (set() still
+    // clones the page it writes to, as every page shares block's count)
+    static RuleTable over(const shared_ptr<vector<uint8_t>>& block) {
+        RuleTable table;
+        table.pages.resize(block->size() / RULE_PAGE_SIZE);
+        table.pageData.resize(table.pages.size());
+        for (int p = 0; p < table.numPages(); p++) {
+            Page* page = reinterpret_cast<Page*>(block->data() + p * RULE_PAGE_SIZE);
+            table.pages[p] = shared_ptr<Page>(block, page);
+            table.pageData[p] = page->data();
+        }
+        return table;
+    }
+
+    size_t size() const {
+        return pages.size() * RULE_PAGE_SIZE;
+    }
+
+    bool empty() const {
+        return pages.empty();
+    }
+
+    int numPages() const {
+        return pages.size();
+    }
+
+    uint8_t operator[](size_t i) const {
+        return pageData[i >> RULE_PAGE_BITS][i & RULE_PAGE_MASK];
+    }
+
+    void set(size_t i, uint8_t value) {
+        writablePage(i >> RULE_PAGE_BITS)[i & RULE_PAGE_MASK] = value;
+    }
+
+    const uint8_t* page(int p) const {
+        return pageData[p];
+    }
+
+    bool sharesPage(const RuleTable& other, int p) const {
+        return pages[p] == other.pages[p];
+    }
+
+    // page p for writing, cloned first if another table shares it
+    uint8_t* writablePage(int p) {
+        if (pages[p].use_count() > 1) {
+            pages[p] = make_shared<Page>(*pages[p]);
+            pageData[p] = pages[p]->data();
+        }
+        return pages[p]->data();
+    }
+
+    // replaces page p by an uninitialised one the caller fills completely
+    uint8_t* newPage(int p) {
+        pages[p] = make_shared<Page>();
+        pageData[p] = pages[p]->data();
+        return pages[p]->data();
+    }
+
+    RuleView view() const {
+        return RuleView{pageData.data()};
+    }
+
+    vector<uint8_t> toVector() const {
+        vector<uint8_t> rules(size());
+        for (int p = 0; p < numPages(); p++) {
+            memcpy(rules.data() + p * RULE_PAGE_SIZE, pageData[p], RULE_PAGE_SIZE);
+        }
+        return rules;
+    }
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+using namespace std;
+
+// Fixed set of worker threads running batches of numbered tasks. The
+// calling thread works on the batch too and run() returns once every task
+// is done, so a pool of size 1 has no workers and runs everything inline.
+// Tasks of one batch must not call run() on the same pool.
+struct ThreadPool {
+    vector<thread> workers;
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+
+    // current batch, read by the workers after they are woken up
+    const function<void(int)>* task = nullptr;
+    int numTasks = 0;
+    atomic<int> nextTask{0};
+    int busy = 0;      // workers not done with the current batch yet
+    long batch = 0;    // number of batches started so far
+    bool stopping = false;
+
+    explicit ThreadPool(int numThreads = 1) {
+        for (int i = 1; i < numThreads; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread & worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const {
+        return workers.size() + 1;
+    }
+
+    // calls fn(i) for every i in [0, count), spread over all threads
+    void run(int count, const function<void(int)>& fn) {
+        if (workers.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) fn(i);
+            return;
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            task = &fn;
+            numTasks = count;
+            nextTask = 0;
+            busy = workers.size();
+            batch++;
+        }
+        wake.notify_all();
+
+        drain(fn, count);
+
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [&] { return busy == 0; });
+        task = nullptr;
+    }
+
+    void drain(const function<void(int)>& fn, int count) {
+        for (int i = nextTask++; i < count; i = nextTask++) fn(i);
+    }
+
+    void workerLoop() {
+        long seen = 0;
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&] { return stopping || batch != seen; });
+            if (stopping) return;
+            seen = batch;
+
+            const function<void(int)>* fn = task;
+            int count = numTasks;
+            guard.unlock();
+            drain(*fn, count);
+            guard.lock();
+
+            if (--busy == 0) done.notify_one();
+        }
+    }
+};
@@ -0,0 +1,396 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "physarum.hpp"
+#include "actions.hpp"
+#include "visited_states.hpp"
+#include "grid_world.hpp"
+using namespace std;
+
+const int TILE_SIZE = 32;
+const int TILE_SLOTS = TILE_SIZE * TILE_SIZE;
+
+struct Tile {
+    int tileX = 0;
+    int tileY = 0;
+
+    int occupants = 0; // cells plus foods with energy left
+
+    // 3x3 block of tiles around this one ([4] is the tile itself),
+    // nullptr where no tile exists
+    Tile* neighbors[9];
+
+    int cellAt[TILE_SLOTS];    // index into cells, -1 if empty
+    int claimAt[TILE_SLOTS];   // index into grown, -1 if unclaimed
+    int foodCount[TILE_SLOTS]; // number of foods with energy left in the slot
+};
+
+// Sparse counterpart of GridWorld for colonies and food layouts too large
+// for one dense grid. The plane is split into TILE_SIZE x TILE_SIZE tiles
+// kept in a hash map; a tile exists only while something occupies it, and
+// lookups across tile edges go through the neighbor pointers cached in each
+// tile, so memory and step cost follow the occupied area, not the extent.
+struct TiledWorld {
+    vector<Cell> cells;
+    vector<Food> foods;
+
+    // genome of the world being simulated, read in place and never copied
+    RuleView rules;
+    Params params;
+
+    unordered_map<pair<int,int>, Tile*> tiles;
+
+    // every tile ever created, reused through freeTiles once dropped
+    vector<unique_ptr<Tile>> tilePool;
+    vector<Tile*> freeTiles;
+
+    vector<Tile*> cellTiles; // tile of every cell
+    vector<Tile*> foodTiles; // tile of every food
+
+    // back buffer and scratch buffers, same roles as in GridWorld
+    vector<Cell> nextCells;
+    vector<Cell> grown;
+    vector<Tile*> grownTiles;
+    vector<int> sendTo;
+    vector<Dir> sendDir;
+    vector<int> received;
+    vector<uint16_t> stateCodes;
+
+    // every state code read from the rules is marked here when set; not owned
+    VisitedStates* visited = nullptr;
+
+    TiledWorld() = default;
+
+    explicit TiledWorld(const World& world) {
+        reset(world);
+    }
+
+    // loads the cells and foods of world and binds its rules, which have to
+    // stay alive and unchanged while this world is stepped
+    void reset(const World& world) {
+        for (auto& [coord, tile] : tiles) freeTiles.push_back(tile);
+        tiles.clear();
+
+        rules = world.rules.view();
+        params = world.params;
+        cells = world.cells;
+        foods = world.foods;
+
+        cellTiles.clear();
+        for (size_t i = 0; i < cells.size(); i++) {
+            Tile* tile = getOrCreateTile(cells[i].x, cells[i].y);
+            tile->cellAt[slotIn(tile, cells[i].x, cells[i].y)] = i;
+            tile->occupants++;
+            cellTiles.push_back(tile);
+        }
+        foodTiles.clear();
+        for (const Food& food : foods) {
+            if (food.energy <= 0) {
+                foodTiles.push_back(nullptr);
+                continue;
+            }
+            Tile* tile = getOrCreateTile(food.x, food.y);
+            tile->foodCount[slotIn(tile, food.x, food.y)]++;
+            tile->occupants++;
+            foodTiles.push_back(tile);
+        }
+    }
+
+    // writes the cells and foods back into world, leaving its rules alone
+    void exportTo(World& world) const {
+        world.cells = cells;
+        World::sortCells(world.cells);
+        world.foods = foods;
+    }
+
+    void step() {
+        updateGrowth();
+        updateEnergy();
+        updateFood();
+        for (int i = 0; i < SIGNALS_PER_STEP; i++) {
+            updateSignals();
+        }
+    }
+
+    // ------------------- TILES -------------------
+
+    static int tileCoord(int v) {
+        return v >= 0 ? v / TILE_SIZE : -((-v - 1) / TILE_SIZE) - 1;
+    }
+
+    static int slotIn(const Tile* tile, int x, int y) {
+        return (y - tile->tileY * TILE_SIZE) * TILE_SIZE + (x - tile->tileX * TILE_SIZE);
+    }
+
+    // tile holding (x, y), looked up from a tile at most one tile away
+    static Tile* tileNear(const Tile* from, int x, int y) {
+        int dx = tileCoord(x) - from->tileX;
+        int dy = tileCoord(y) - from->tileY;
+        return from->neighbors[(dy + 1) * 3 + dx + 1];
+    }
+
+    static int cellIndexNear(const Tile* from, int x, int y) {
+        const Tile* tile = tileNear(from, x, y);
+        return tile == nullptr ? -1 : tile->cellAt[slotIn(tile, x, y)];
+    }
+
+    Tile* getOrCreateTile(int x, int y) {
+        pair<int,int> coord{tileCoord(x), tileCoord(y)};
+        auto it = tiles.find(coord);
+        if (it != tiles.end()) return it->second;
+
+        Tile* tile;
+        if (freeTiles.empty()) {
+            tilePool.push_back(make_unique<Tile>());
+            tile = tilePool.back().get();
+        } else {
+            tile = freeTiles.back();
+            freeTiles.pop_back();
+        }
+        tile->tileX = coord.first;
+        tile->tileY = coord.second;
+        tile->occupants = 0;
+        std::fill(begin(tile->cellAt), end(tile->cellAt), -1);
+        std::fill(begin(tile->claimAt), end(tile->claimAt), -1);
+        std::fill(begin(tile->foodCount), end(tile->foodCount), 0);
+
+        // link with the existing tiles around it, both ways
+        for (int k = 0; k < 9; k++) {
+            if (k == 4) { tile->neighbors[k] = tile; continue; }
+            auto n = tiles.find({coord.first + k % 3 - 1, coord.second + k / 3 - 1});
+            tile->neighbors[k] = n == tiles.end() ? nullptr : n->second;
+            if (tile->neighbors[k] != nullptr) tile->neighbors[k]->neighbors[8 - k] = tile;
+        }
+        tiles[coord] = tile;
+        return tile;
+    }
+
+    void dropTile(Tile* tile) {
+        for (int k = 0; k < 9; k++) {
+            if (k != 4 && tile->neighbors[k] != nullptr) tile->neighbors[k]->neighbors[8 - k] = nullptr;
+        }
+        tiles.erase({tile->tileX, tile->tileY});
+        freeTiles.push_back(tile);
+    }
+
+    // ------------------- PHASES -------------------
+
+    void updateGrowth() {
+
+        grown.clear();
+        grownTiles.clear();
+
+        computeStateCodes();
+
+        for (size_t i = 0; i < cells.size(); i++) {
+
+            Cell & cell = cells[i];
+
+            uint8_t action = rules[stateCodes[i]];
+            Dir growthDir = ACTION_TABLE[action].growth;
+
+            if (growthDir == DIR_NONE || cell.energy < params.minGrowthEnergy) continue;
+
+            int targetX = cell.x + DIR_DX[growthDir];
+            int targetY = cell.y + DIR_DY[growthDir];
+
+            // obstacles are checked against the cells from before this phase
+            Tile* target = tileNear(cellTiles[i], targetX, targetY);
+            if (target != nullptr) {
+                int slot = slotIn(target, targetX, targetY);
+                if (target->cellAt[slot] >= 0 || target->foodCount[slot] > 0) continue;
+            } else {
+                target = getOrCreateTile(targetX, targetY);
+            }
+
+            Cell child = Cell{targetX, targetY, cell.energy / 2, 'n'};
+            cell.energy /= 2;
+
+            // several cells growing into the same slot: the strongest wins
+            int &claim = target->claimAt[slotIn(target, targetX, targetY)];
+            if (claim < 0) {
+                claim = grown.size();
+                grown.push_back(child);
+                grownTiles.push_back(target);
+            } else if (grown[claim].energy < child.energy) {
+                grown[claim] = child;
+            }
+        }
+
+        for (size_t k = 0; k < grown.size(); k++) {
+            Tile* tile = grownTiles[k];
+            int slot = slotIn(tile, grown[k].x, grown[k].y);
+            tile->claimAt[slot] = -1;
+            tile->cellAt[slot] = cells.size();
+            tile->occupants++;
+            cells.push_back(grown[k]);
+            cellTiles.push_back(tile);
+        }
+    }
+
+    void updateEnergy() {
+
+        nextCells = cells;
+        sendTo.assign(cells.size(), -1);
+        received.assign(cells.size(), 0);
+
+        computeStateCodes();
+
+        for (size_t i = 0; i < cells.size(); i++) {
+
+            const Cell & cell = cells[i];
+
+            uint8_t action = rules[stateCodes[i]];
+            Dir energyDir = ACTION_TABLE[action].energy;
+
+            // no energy passed
+            if (energyDir == DIR_NONE || cell.energy * params.energyPortion < params.minEnergyToPassEnergy) continue;
+
+            int targetX = cell.x + DIR_DX[energyDir];
+            int targetY = cell.y + DIR_DY[energyDir];
+
+            // if target cell does not exist, do not pass energy
+            int target = cellIndexNear(cellTiles[i], targetX, targetY);
+            if (target < 0) continue;
+
+            nextCells[i].energy *= (1 - params.energyPortion);
+            nextCells[i].energyDir = DIR_CHARS[energyDir];
+            sendTo[i] = target;
+            received[target]++;
+        }
+
+        // same summation order as GridWorld::updateEnergy
+        for (size_t i = 0; i < cells.size(); i++) {
+            if (received[i] == 0) continue;
+
+            const Cell & cell = cells[i];
+            float portion = cell.energy * params.energyPortion;
+            float newEnergy = 0;
+
+            for (int k = 0; k < 4; k++) {
+                if (k == 2) newEnergy += nextCells[i].energy;
+                int sender = cellIndexNear(cellTiles[i], cell.x + NEIGHBOR_OFFSETS[k][0], cell.y + NEIGHBOR_OFFSETS[k][1]);
+                if (sender >= 0 && sendTo[sender] == static_cast<int>(i)) newEnergy += portion;
+            }
+            nextCells[i] = Cell{cell.x, cell.y, newEnergy, 'n'};
+        }
+
+        swap(cells, nextCells);
+    }
+
+    void updateFood() {
+
+        for (size_t f = 0; f < foods.size(); f++) {
+            Food & food = foods[f];
+            if (food.energy <= 0) continue;
+            for (const auto & offset : NEIGHBOR_OFFSETS) {
+                int cell = cellIndexNear(foodTiles[f], food.x + offset[0], food.y + offset[1]);
+                if (cell < 0) continue;
+
+                food.energy -= 1;
+                cells[cell].energy += 1;
+                if (food.energy <= 0) break;
+            }
+            if (food.energy <= 0) {
+                Tile* tile = foodTiles[f];
+                tile->foodCount[slotIn(tile, food.x, food.y)]--;
+                if (--tile->occupants == 0) dropTile(tile);
+            }
+        }
+
+        // remove depleted foods
+        size_t kept = 0;
+        for (size_t f = 0; f < foods.size(); f++) {
+            if (foods[f].energy <= 0) continue;
+            foods[kept] = foods[f];
+            foodTiles[kept] = foodTiles[f];
+            kept++;
+        }
+        foods.resize(kept);
+        foodTiles.resize(kept);
+    }
+
+    void updateSignals() {
+
+        nextCells = cells;
+        sendTo.assign(cells.size(), -1);
+        sendDir.assign(cells.size(), DIR_NONE);
+
+        computeStateCodes();
+
+        for (size_t i = 0; i < cells.size(); i++) {
+
+            const Cell & cell = cells[i];
+
+            uint8_t action = rules[stateCodes[i]];
+            Dir signalDir = ACTION_TABLE[action].signal;
+
+            if (signalDir == DIR_NONE || cell.energy < params.minEnergyToSignal) continue;
+
+            int targetX = cell.x + DIR_DX[signalDir];
+            int targetY = cell.y + DIR_DY[signalDir];
+
+            int target = cellIndexNear(cellTiles[i], targetX, targetY);
+            if (target < 0) continue; // no target
+
+            nextCells[i].energy -= params.signalCost;
+            sendTo[i] = target;
+            sendDir[i] = signalDir;
+        }
+
+        // receivers shift in the signals of their neighbors in row-major order
+        for (size_t i = 0; i < cells.size(); i++) {
+            const Cell & cell = cells[i];
+            for (const auto & offset : NEIGHBOR_OFFSETS) {
+                int sender = cellIndexNear(cellTiles[i], cell.x + offset[0], cell.y + offset[1]);
+                if (sender < 0 || sendTo[sender] != static_cast<int>(i)) continue;
+
+                uint8_t &mem = nextCells[i].memory;
+                mem = ((mem << 2) | SIGNAL_VALUES[sendDir[sender]]) & ((1 << (MEMORY_SIZE*2)) - 1);
+            }
+        }
+
+        swap(cells, nextCells);
+    }
+
+    // ------------------- RULES -------------------
+
+    // same encoding as World::getCellState, with every neighbor looked up
+    // from the cell's own tile
+    void computeStateCodes() {
+        stateCodes.resize(cells.size());
+
+        for (size_t i = 0; i < cells.size(); i++) {
+            const Cell & cell = cells[i];
+            const Tile* tile = cellTiles[i];
+            uint16_t state = 0;
+            int c;
+
+            if ((c = cellIndexNear(tile, cell.x - 1, cell.y)) >= 0) { // neighbor left
+                state += 1;
+                if (cells[c].energyDir == 'r') state += 1 << 4;
+            }
+            if ((c = cellIndexNear(tile, cell.x + 1, cell.y)) >= 0) { // neighbor right
+                state += 1 << 1;
+                if (cells[c].energyDir == 'l') state += 1 << 5;
+            }
+            if ((c = cellIndexNear(tile, cell.x, cell.y - 1)) >= 0) { // neighbor up
+                state += 1 << 2;
+                if (cells[c].energyDir == 'd') state += 1 << 6;
+            }
+            if ((c = cellIndexNear(tile, cell.x - 1, cell.y + 1)) >= 0) { // neighbor down, as read by World
+                state += 1 << 3;
+                if (cells[c].energyDir == 'u') state += 1 << 7;
+            }
+            if (cellIndexNear(tile, cell.x - 1, cell.y - 1) >= 0) state += 1 << 8;
+            if (cellIndexNear(tile, cell.x + 1, cell.y - 1) >= 0) state += 1 << 9;
+            if (cellIndexNear(tile, cell.x + 1, cell.y + 1) >= 0) state += 1 << 11;
+
+            state |= (static_cast<uint16_t>(cell.memory & ((1 << (MEMORY_SIZE*2)) - 1)) << 12);
+            stateCodes[i] = state;
+            if (visited) visited->mark(state);
+        }
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "physarum.hpp"
+using namespace std;
+
+// One bit per state code (index into the rule table), set once a cell was
+// in that state, i.e. once the rule at that index was read.
+struct VisitedStates {
+    vector<uint64_t> words = vector<uint64_t>(STATE_SPACE / 64, 0);
+
+    // can be called from several threads at once
+    void mark(uint32_t code) {
+        uint64_t bit = uint64_t(1) << (code % 64);
+        uint64_t* word = &words[code / 64];
+        if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+        }
+    }
+
+    bool test(uint32_t code) const {
+        return (words[code / 64] >> (code % 64)) & 1;
+    }
+
+    void clear() {
+        std::fill(words.begin(), words.end(), 0);
+    }
+
+    void merge(const VisitedStates& other) {
+        for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+    }
+
+    int count() const {
+        int visited = 0;
+        for (uint64_t word : words) visited += __builtin_popcountll(word);
+        return visited;
+    }
+
+    // calls visit(code) for every visited code, in ascending order
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t bits = words[i];
+            while (bits) {
+                visit(static_cast<uint32_t>(i * 64 + __builtin_ctzll(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+};
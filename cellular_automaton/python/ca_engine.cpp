@@ -0,0 +1,465 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <memory>
+#include <random>
+#include <limits>
+#include "gen_alg.hpp"
+using namespace std;
+
+// Python module ca_engine: the C++ World and its engines for the Python
+// tooling, built by setup.py next to this file.
+//
+//   world = ca_engine.World(rules, seed=1)   # one cell at the origin
+//   world = ca_engine.World(rules, config={"energy_portion": 0.1})
+//   world.step(100)                          # without holding the GIL
+//   world.fitness(), world.stats()
+//   numpy.asarray(world.rules)               # writable, in place
+//   numpy.asarray(world.cells)               # structured, read-only
+//   ca_engine.evaluate([rules, ...], seed=1) # like the GA, on all cores
+//
+// Rules are any buffer of STATE_SPACE action codes below ACTION_SPACE
+// (bytes, bytearray, uint8 numpy arrays), and configs dicts of the keys gen_alg takes (see Config). Views
+// of cells and foods point into the world itself, so the world cannot step
+// while one of them is alive.
+
+static_assert(sizeof(Cell) == 16 && sizeof(Food) == 12, "update the buffer formats below");
+
+const char* CELL_FORMAT = "T{i:x:i:y:f:energy:c:energy_dir:B:memory:2x}";
+const char* FOOD_FORMAT = "T{i:x:i:y:f:energy:}";
+
+// ------------------- CONVERSIONS -------------------
+
+// the engines decode rules through ACTION_TABLE, so every rule has to be
+// an action code; false with a ValueError set otherwise
+static bool checkRules(const uint8_t* rules) {
+    for (int code = 0; code < STATE_SPACE; code++) {
+        if (rules[code] >= ACTION_SPACE) {
+            PyErr_Format(PyExc_ValueError, "rule %d is %d, actions go up to %d", code, rules[code], ACTION_SPACE - 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+// copies a buffer of STATE_SPACE action codes into block, false with an
+// exception set otherwise
+static bool readRules(PyObject* obj, uint8_t* block) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS) != 0) return false;
+    bool ok = view.len == STATE_SPACE;
+    if (ok) {
+        ok = checkRules(static_cast<const uint8_t*>(view.buf));
+        if (ok) memcpy(block, view.buf, STATE_SPACE);
+    } else {
+        PyErr_Format(PyExc_ValueError, "rules must hold %d bytes, got %zd", STATE_SPACE, view.len);
+    }
+    PyBuffer_Release(&view);
+    return ok;
+}
+
+// applies the {key: value} pairs of obj (unless None) to config
+static bool readConfig(PyObject* obj, Config& config) {
+    if (obj == Py_None) return true;
+    if (!PyDict_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "config must be a dict");
+        return false;
+    }
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(obj, &pos, &key, &value)) {
+        PyObject* keyText = PyObject_Str(key);
+        PyObject* valueText = PyBool_Check(value) ? PyUnicode_FromString(value == Py_True ? "true" : "false")
+                                                  : PyObject_Str(value);
+        bool ok = keyText && valueText;
+        if (ok) {
+            try {
+                config.set(PyUnicode_AsUTF8(keyText), PyUnicode_AsUTF8(valueText));
+            } catch (const invalid_argument& e) {
+                PyErr_SetString(PyExc_ValueError, e.what());
+                ok = false;
+            }
+        }
+        Py_XDECREF(keyText);
+        Py_XDECREF(valueText);
+        if (!ok) return false;
+    }
+    try {
+        config.check();
+    } catch (const invalid_argument& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return false;
+    }
+    return true;
+}
+
+// foods from a sequence of (x, y, energy), or a random layout if obj is None
+static bool readFoods(PyObject* obj, PyObject* seed, const Config& config, vector<Food>& foods) {
+    if (obj == Py_None) {
+        if (seed == Py_None) {
+            foods = getRandomizedFood(config, globalRng());
+        } else {
+            std::mt19937 rng(PyLong_AsUnsignedLongMask(seed));
+            if (PyErr_Occurred()) return false;
+            foods = getRandomizedFood(config, rng);
+        }
+        return true;
+    }
+    PyObject* items = PySequence_Fast(obj, "foods must be a sequence of (x, y, energy)");
+    if (!items) return false;
+    foods.clear();
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(items); i++) {
+        Food food;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(items, i), "iif", &food.x, &food.y, &food.energy)) {
+            Py_DECREF(items);
+            return false;
+        }
+        foods.push_back(food);
+    }
+    Py_DECREF(items);
+    return true;
+}
+
+static PyObject* statsDict(const FitnessStats& stats) {
+    return Py_BuildValue("{s:i,s:i,s:f,s:f,s:(iiii)}",
+        "cells", stats.cells,
+        "low_energy_cells", stats.lowEnergyCells,
+        "average_distance", stats.cells > 0 ? stats.averageDistance() : 0.0f,
+        "food_energy", stats.foodEnergy,
+        "bbox", stats.minX, stats.maxX, stats.minY, stats.maxY);
+}
+
+// ------------------- WORLD -------------------
+
+struct WorldState {
+    shared_ptr<vector<uint8_t>> rules = make_shared<vector<uint8_t>>(STATE_SPACE);
+    Config config;
+    World world;
+    Engines engines;
+    int steps = 0;
+};
+
+struct PyWorld {
+    PyObject_HEAD
+    WorldState* state;
+    int exports; // cell and food views alive
+    bool busy;   // stepped by a thread that released the GIL
+};
+
+enum ArrayKind { RULES, CELLS, FOODS };
+
+// exporter of one array of a world, what the views returned by the world's
+// attributes are made from
+struct PyArrayView {
+    PyObject_HEAD
+    PyWorld* owner;
+    ArrayKind kind;
+};
+
+static PyTypeObject PyWorldType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+static PyTypeObject PyArrayViewType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+static bool checkIdle(PyWorld* self) {
+    if (self->busy) PyErr_SetString(PyExc_RuntimeError, "the world is being stepped by another thread");
+    return !self->busy;
+}
+
+static PyObject* World_new(PyTypeObject* type, PyObject*, PyObject*) {
+    PyWorld* self = reinterpret_cast<PyWorld*>(type->tp_alloc(type, 0));
+    if (!self) return nullptr;
+    self->state = new WorldState;
+    self->state->world.rules = RuleTable::over(self->state->rules);
+    self->exports = 0;
+    self->busy = false;
+    return reinterpret_cast<PyObject*>(self);
+}
+
+static void World_dealloc(PyWorld* self) {
+    delete self->state;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static int World_init(PyWorld* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"rules", "foods", "seed", "config", nullptr};
+    PyObject* rules;
+    PyObject* foods = Py_None;
+    PyObject* seed = Py_None;
+    PyObject* config = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO", const_cast<char**>(keywords), &rules, &foods, &seed, &config)) {
+        return -1;
+    }
+    if (!checkIdle(self)) return -1;
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot reinitialise a world whose cells or foods are viewed");
+        return -1;
+    }
+
+    Config newConfig;
+    if (!readConfig(config, newConfig)) return -1;
+    self->state->config = newConfig;
+
+    World& world = self->state->world;
+    world.params = newConfig.world;
+    if (!readRules(rules, self->state->rules->data())) return -1;
+    if (!readFoods(foods, seed, newConfig, world.foods)) return -1;
+    world.cells = {Cell{0, 0, newConfig.initialEnergy, 'n'}};
+    self->state->steps = 0;
+    return 0;
+}
+
+static PyObject* World_step(PyWorld* self, PyObject* args) {
+    int steps = 1;
+    if (!PyArg_ParseTuple(args, "|i", &steps)) return nullptr;
+    if (!checkIdle(self)) return nullptr;
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot step a world whose cells or foods are viewed");
+        return nullptr;
+    }
+
+    WorldState* state = self->state;
+    // the writable rules view may have put anything into the table
+    if (!checkRules(state->rules->data())) return nullptr;
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    simulate(state->world, steps, state->engines, state->config.engine);
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+    state->steps += steps;
+    Py_RETURN_NONE;
+}
+
+static PyObject* World_fitness(PyWorld* self, PyObject*) {
+    if (!checkIdle(self)) return nullptr;
+    return PyFloat_FromDouble(calculateFitness(FitnessStats::of(self->state->world), self->state->config));
+}
+
+static PyObject* World_stats(PyWorld* self, PyObject*) {
+    if (!checkIdle(self)) return nullptr;
+    return statsDict(FitnessStats::of(self->state->world));
+}
+
+static PyObject* World_view(PyWorld* self, void* closure) {
+    if (!checkIdle(self)) return nullptr;
+    PyArrayView* view = PyObject_New(PyArrayView, &PyArrayViewType);
+    if (!view) return nullptr;
+    Py_INCREF(self);
+    view->owner = self;
+    view->kind = static_cast<ArrayKind>(reinterpret_cast<intptr_t>(closure));
+    PyObject* memory = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(view));
+    Py_DECREF(view);
+    return memory;
+}
+
+static PyObject* World_getSteps(PyWorld* self, void*) {
+    return PyLong_FromLong(self->state->steps);
+}
+
+static PyMethodDef World_methods[] = {
+    {"step", reinterpret_cast<PyCFunction>(World_step), METH_VARARGS,
+     "step(steps=1)\n\nAdvances the world by steps steps with the configured engine, without holding the GIL."},
+    {"fitness", reinterpret_cast<PyCFunction>(World_fitness), METH_NOARGS,
+     "fitness()\n\nFitness of the current state, as the genetic algorithm computes it."},
+    {"stats", reinterpret_cast<PyCFunction>(World_stats), METH_NOARGS,
+     "stats()\n\nRunning totals the fitness terms are computed from."},
+    {nullptr}
+};
+
+static PyGetSetDef World_getset[] = {
+    {"rules", reinterpret_cast<getter>(World_view), nullptr,
+     "Writable uint8 view of the rule table; writes change the rules of the next steps, which check that they are all below ACTION_SPACE.",
+     reinterpret_cast<void*>(RULES)},
+    {"cells", reinterpret_cast<getter>(World_view), nullptr,
+     "Read-only view of the cells (x, y, energy, energy_dir, memory).",
+     reinterpret_cast<void*>(CELLS)},
+    {"foods", reinterpret_cast<getter>(World_view), nullptr,
+     "Read-only view of the foods (x, y, energy).",
+     reinterpret_cast<void*>(FOODS)},
+    {"steps", reinterpret_cast<getter>(World_getSteps), nullptr,
+     "Number of steps since the world was created.", nullptr},
+    {nullptr}
+};
+
+// ------------------- ARRAY VIEWS -------------------
+
+static void ArrayView_dealloc(PyArrayView* self) {
+    Py_DECREF(self->owner);
+    PyObject_Free(self);
+}
+
+static int ArrayView_getbuffer(PyArrayView* self, Py_buffer* view, int flags) {
+    WorldState* state = self->owner->state;
+    bool writable = self->kind == RULES;
+    if ((flags & PyBUF_WRITABLE) && !writable) {
+        PyErr_SetString(PyExc_BufferError, "cells and foods are read-only");
+        return -1;
+    }
+
+    static char empty = 0;
+    void* data;
+    Py_ssize_t count;
+    Py_ssize_t itemSize;
+    const char* format;
+    if (self->kind == RULES) {
+        data = state->rules->data();
+        count = STATE_SPACE;
+        itemSize = 1;
+        format = "B";
+    } else if (self->kind == CELLS) {
+        data = state->world.cells.empty() ? &empty : static_cast<void*>(state->world.cells.data());
+        count = state->world.cells.size();
+        itemSize = sizeof(Cell);
+        format = CELL_FORMAT;
+    } else {
+        data = state->world.foods.empty() ? &empty : static_cast<void*>(state->world.foods.data());
+        count = state->world.foods.size();
+        itemSize = sizeof(Food);
+        format = FOOD_FORMAT;
+    }
+
+    view->obj = reinterpret_cast<PyObject*>(self);
+    Py_INCREF(self);
+    view->buf = data;
+    view->len = count * itemSize;
+    view->readonly = !writable;
+    view->itemsize = itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(format) : nullptr;
+    view->ndim = 1;
+    view->shape = nullptr;
+    view->strides = nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    if (flags & PyBUF_ND) {
+        // shape and strides live in the view's internal storage
+        Py_ssize_t* shape = static_cast<Py_ssize_t*>(PyMem_Malloc(2 * sizeof(Py_ssize_t)));
+        if (!shape) {
+            Py_CLEAR(view->obj);
+            PyErr_NoMemory();
+            return -1;
+        }
+        shape[0] = count;
+        shape[1] = itemSize;
+        view->shape = shape;
+        if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) view->strides = shape + 1;
+        view->internal = shape;
+    }
+
+    if (self->kind != RULES) self->owner->exports++;
+    return 0;
+}
+
+static void ArrayView_releasebuffer(PyArrayView* self, Py_buffer* view) {
+    PyMem_Free(view->internal);
+    if (self->kind != RULES) self->owner->exports--;
+}
+
+static PyBufferProcs ArrayView_buffer = {
+    reinterpret_cast<getbufferproc>(ArrayView_getbuffer),
+    reinterpret_cast<releasebufferproc>(ArrayView_releasebuffer),
+};
+
+// ------------------- EVALUATION -------------------
+
+// evaluates every genome like the genetic algorithm does, each on its own
+// food stream seeded from seed and its index, spread over threads threads
+static PyObject* evaluate(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"population", "seed", "threads", "elite_cutoff", "config", nullptr};
+    PyObject* population;
+    unsigned long seed = 0;
+    int threads = 0;
+    float eliteCutoff = -numeric_limits<float>::infinity();
+    PyObject* configDict = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|kifO", const_cast<char**>(keywords),
+                                     &population, &seed, &threads, &eliteCutoff, &configDict)) {
+        return nullptr;
+    }
+    Config config;
+    if (!readConfig(configDict, config)) return nullptr;
+
+    PyObject* items = PySequence_Fast(population, "population must be a sequence of rule tables");
+    if (!items) return nullptr;
+    int size = PySequence_Fast_GET_SIZE(items);
+    vector<World> worlds(size);
+    for (int i = 0; i < size; i++) {
+        auto block = make_shared<vector<uint8_t>>(STATE_SPACE);
+        if (!readRules(PySequence_Fast_GET_ITEM(items, i), block->data())) {
+            Py_DECREF(items);
+            return nullptr;
+        }
+        worlds[i].rules = RuleTable::over(block);
+    }
+    Py_DECREF(items);
+
+    vector<Evaluation> results(size);
+    Py_BEGIN_ALLOW_THREADS
+    ThreadPool pool(threads > 0 ? threads : max(1u, thread::hardware_concurrency()));
+    vector<Engines> workerEngines(pool.size());
+    atomic<int> next{0};
+    pool.run(pool.size(), [&](int worker) {
+        for (int i = next++; i < size; i = next++) {
+            std::seed_seq streamSeed{static_cast<uint32_t>(seed), static_cast<uint32_t>(i)};
+            std::mt19937 rng(streamSeed);
+            results[i] = evaluateIndividual(worlds[i], config, workerEngines[worker], rng, eliteCutoff);
+        }
+    });
+    Py_END_ALLOW_THREADS
+
+    PyObject* fitnesses = PyList_New(size);
+    if (!fitnesses) return nullptr;
+    for (int i = 0; i < size; i++) {
+        PyList_SET_ITEM(fitnesses, i, Py_BuildValue("(fi)", results[i].fitness, results[i].tries));
+    }
+    return fitnesses;
+}
+
+// ------------------- MODULE -------------------
+
+static PyMethodDef module_methods[] = {
+    {"evaluate", reinterpret_cast<PyCFunction>(evaluate), METH_VARARGS | METH_KEYWORDS,
+     "evaluate(population, seed=0, threads=0, elite_cutoff=-inf, config=None)\n\n"
+     "Evaluates every rule table of population over num_tries tries of num_steps steps, racing them\n"
+     "against elite_cutoff, on threads threads (0 for all cores). Returns a (fitness, tries) pair\n"
+     "per rule table; results only depend on seed and the order of population."},
+    {nullptr}
+};
+
+static PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "ca_engine", "C++ engine of the cellular automaton.", -1, module_methods,
+};
+
+PyMODINIT_FUNC PyInit_ca_engine() {
+    PyWorldType.tp_name = "ca_engine.World";
+    PyWorldType.tp_doc = "World(rules, foods=None, seed=None, config=None)\n\n"
+                         "A world with one cell at the origin. foods is a sequence of (x, y, energy); by default\n"
+                         "food is laid out at random like in the genetic algorithm, from seed if given. config is a\n"
+                         "dict of gen_alg parameters, e.g. {\"energy_portion\": 0.1}.";
+    PyWorldType.tp_basicsize = sizeof(PyWorld);
+    PyWorldType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyWorldType.tp_new = World_new;
+    PyWorldType.tp_init = reinterpret_cast<initproc>(World_init);
+    PyWorldType.tp_dealloc = reinterpret_cast<destructor>(World_dealloc);
+    PyWorldType.tp_methods = World_methods;
+    PyWorldType.tp_getset = World_getset;
+
+    PyArrayViewType.tp_name = "ca_engine.ArrayView";
+    PyArrayViewType.tp_basicsize = sizeof(PyArrayView);
+    PyArrayViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyArrayViewType.tp_dealloc = reinterpret_cast<destructor>(ArrayView_dealloc);
+    PyArrayViewType.tp_as_buffer = &ArrayView_buffer;
+
+    if (PyType_Ready(&PyWorldType) < 0 || PyType_Ready(&PyArrayViewType) < 0) return nullptr;
+
+    PyObject* m = PyModule_Create(&module);
+    if (!m) return nullptr;
+
+    Py_INCREF(&PyWorldType);
+    if (PyModule_AddObject(m, "World", reinterpret_cast<PyObject*>(&PyWorldType)) < 0) {
+        Py_DECREF(&PyWorldType);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    PyModule_AddIntConstant(m, "STATE_SPACE", STATE_SPACE);
+    PyModule_AddIntConstant(m, "ACTION_SPACE", ACTION_SPACE);
+    PyModule_AddIntConstant(m, "NUM_TRIES", NUM_TRIES);
+    PyModule_AddIntConstant(m, "NUM_STEPS", NUM_STEPS);
+    return m;
+}
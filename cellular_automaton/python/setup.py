@@ -0,0 +1,23 @@
+# Builds ca_engine, the C++ cellular automaton engine as a Python module:
+#
+#   python setup.py build_ext --inplace
+#
+# then `import ca_engine` from this directory (see ca_engine.cpp).
+
+from setuptools import setup, Extension
+
+ca_engine = Extension(
+    'ca_engine',
+    sources=['ca_engine.cpp'],
+    include_dirs=['../cpp'],
+    language='c++',
+    extra_compile_args=['-std=c++17', '-O3', '-march=native', '-pthread'],
+    extra_link_args=['-pthread'],
+)
+
+setup(
+    name='ca_engine',
+    version='0.1',
+    description='C++ engine of the physarum cellular automaton',
+    ext_modules=[ca_engine],
+)
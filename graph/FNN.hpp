@@ -1,6 +1,8 @@
 #include <vector>
+#include <array>
 #include <cmath>
 #include <string>
+#include <algorithm>
 
 using namespace std;
 #include <functional>
@@ -74,4 +76,115 @@ struct FNN {
     vector<double> predict(const vector<double>& input) {
         return forward(input);
     }
-};
\ No newline at end of file
+};
+
+// Feed-forward net whose layer shapes are fixed at compile time by DIMS,
+// (inputs, outputs) per layer, ReLU on hidden layers and sigmoid on the
+// output one like FNN. All weights live in one aligned buffer, layer after
+// layer: the weight rows (one per input, padded to a multiple of 4 outputs)
+// and then the biases. A layer adds input k times row k to the biases, so
+// each output sums its terms in the same order as FNN and gets the same
+// value, while the 4 outputs of a row chunk are computed as one vector.
+// Activations live on the stack; forward allocates nothing.
+template <const auto& DIMS>
+struct FlatFNN {
+
+    static constexpr int NUM_LAYERS = DIMS.size();
+    static constexpr int NUM_INPUTS = DIMS[0].first;
+    static constexpr int NUM_OUTPUTS = DIMS[NUM_LAYERS - 1].second;
+
+    static constexpr int padded(int n) {
+        return (n + 3) / 4 * 4;
+    }
+
+    // start of layer l in the weight buffer, and the buffer's size for l = NUM_LAYERS
+    static constexpr int offset(int l) {
+        int size = 0;
+        for (int i = 0; i < l; ++i) {
+            size += (DIMS[i].first + 1) * padded(DIMS[i].second);
+        }
+        return size;
+    }
+
+    static constexpr int maxWidth() {
+        int width = padded(NUM_INPUTS);
+        for (int i = 0; i < NUM_LAYERS; ++i) {
+            width = std::max(width, padded(DIMS[i].second));
+        }
+        return width;
+    }
+
+    static constexpr bool chained() {
+        for (int i = 1; i < NUM_LAYERS; ++i) {
+            if (DIMS[i].first != DIMS[i - 1].second) return false;
+        }
+        return true;
+    }
+    static_assert(chained(), "each layer has to take the outputs of the previous one");
+
+    alignas(32) array<double, offset(NUM_LAYERS)> params{};
+
+    // weights in the layout of FNN::initialize (weight matrix, then a row
+    // of biases, per layer)
+    void initialize(const vector<vector<vector<double>>>& weights) {
+        params.fill(0.0);
+        for (int l = 0; l < NUM_LAYERS; ++l) {
+            int in = DIMS[l].first, out = DIMS[l].second, stride = padded(out);
+            double* layer = params.data() + offset(l);
+            for (int k = 0; k < in; ++k) {
+                for (int j = 0; j < out; ++j) {
+                    layer[k * stride + j] = weights[l * 2][k][j];
+                }
+            }
+            for (int j = 0; j < out; ++j) {
+                layer[in * stride + j] = weights[l * 2 + 1][0][j];
+            }
+        }
+    }
+
+    static double relu(double x) {
+        return x > 0 ? x : 0.0;
+    }
+
+    static double sigmoid(double x) {
+        if (x >= 0) return 1.0 / (1.0 + exp(-x));
+        double e = exp(x);
+        return e / (1.0 + e);
+    }
+
+    template <int L>
+    void layer(const double* in, double* out) const {
+        constexpr int IN = DIMS[L].first, OUT = DIMS[L].second, STRIDE = padded(OUT);
+        const double* w = params.data() + offset(L);
+
+        alignas(32) double sum[STRIDE];
+        for (int j = 0; j < STRIDE; ++j) sum[j] = w[IN * STRIDE + j];
+        for (int k = 0; k < IN; ++k) {
+            const double x = in[k];
+            const double* row = w + k * STRIDE;
+            for (int j = 0; j < STRIDE; ++j) sum[j] += x * row[j];
+        }
+        for (int j = 0; j < OUT; ++j) {
+            out[j] = L == NUM_LAYERS - 1 ? sigmoid(sum[j]) : relu(sum[j]);
+        }
+    }
+
+    template <int L>
+    void forwardFrom(double* a, double* b) const {
+        layer<L>(a, b);
+        if constexpr (L + 1 < NUM_LAYERS) forwardFrom<L + 1>(b, a);
+    }
+
+    // inputs missing from the end of input count as 0, as in FNN, where
+    // the weights of inputs not given are never read
+    array<double, NUM_OUTPUTS> predict(const array<double, NUM_INPUTS>& input) const {
+        alignas(32) double a[maxWidth()];
+        alignas(32) double b[maxWidth()];
+        std::copy(input.begin(), input.end(), a);
+        forwardFrom<0>(a, b);
+
+        array<double, NUM_OUTPUTS> output;
+        std::copy(NUM_LAYERS % 2 == 1 ? b : a, (NUM_LAYERS % 2 == 1 ? b : a) + NUM_OUTPUTS, output.begin());
+        return output;
+    }
+};
@@ -146,13 +146,13 @@ void drawGrid(sf::RenderWindow& window) {
 }
 
 
-World readWorld(int gen) {
+World readWorld(int gen, const Config& config) {
 
     vector<unique_ptr<Junction>> junctions;
-    junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-    vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
+    junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+    vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
     Genome genome = readGenome(gen);
-    World world(genome);
+    World world(genome, config.world);
     world.placeNewFoodSources(std::move(foodSources));
     world.placeNewJunctions(std::move(junctions));
     return world;
@@ -167,9 +167,17 @@ int main(int argc, char* argv[]) {
         gen = std::stoi(argv[1]);
     }
 
+    // the other arguments configure the worlds, as for gen_alg
+    Config config;
+    try {
+        config = loadConfig(vector<string>(argv + min(argc, 2), argv + argc));
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
 
-    World world = readWorld(gen);
-    world.run(NUM_STEPS, true);
+    World world = readWorld(gen, config);
+    world.run(config.numSteps, true);
     vector<Frame> frames = loadFrames();
 
     size_t currentFrame = 0;
@@ -221,8 +229,8 @@ int main(int argc, char* argv[]) {
                 // restart animation with next genome
                 else if (event.key.code == sf::Keyboard::Enter) {
                     drawLoadingScreen(window, font);
-                    world = readWorld(gen);
-                    world.run(NUM_STEPS, true);
+                    world = readWorld(gen, config);
+                    world.run(config.numSteps, true);
                     frames = loadFrames();
                     currentFrame = 0;
                     paused = false;
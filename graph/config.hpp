@@ -0,0 +1,165 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "physarum.hpp"
+
+using namespace std;
+
+// Defaults of the parameters of a genetic algorithm run, see Config.
+
+const int NUM_GENERATIONS = 10000;
+const int POPULATION_SIZE = 30;
+const int NUM_TRIES = 16;
+
+const int NUM_STEPS = 200; // -> more over time (?)
+
+const float ELITE_PROPORTION = 0.4f;
+const float CROSSED_PROPORTION = 0.1f;
+
+const double DEFAULT_MUTATION_RATE = 0.2;
+const double MUTATION_STRENGTH = 0.5;
+
+const double INITIAL_ENERGY = 1.1 * MAX_JUNCTION_ENERGY;
+
+const int NUM_FOOD_SOURCES_LARGE = 30;
+
+const double MAX_DIST_FROM_ORIG = 500.0;
+
+// Parameters of one genetic algorithm run, with the physics of its worlds
+// in world. They are read from files and command line arguments as
+// `key = value`, keys being the names listed in forEachField.
+struct Config {
+    Params world;
+
+    int numGenerations = NUM_GENERATIONS;
+    int populationSize = POPULATION_SIZE;
+    int numTries = NUM_TRIES;
+    int numSteps = NUM_STEPS;
+    float eliteProportion = ELITE_PROPORTION;
+    float crossedProportion = CROSSED_PROPORTION;
+    double mutationRate = DEFAULT_MUTATION_RATE;
+    double mutationStrength = MUTATION_STRENGTH;
+
+    double initialEnergy = INITIAL_ENERGY;
+    int numFoodSourcesLarge = NUM_FOOD_SOURCES_LARGE;
+    double maxDistFromOrig = MAX_DIST_FROM_ORIG;
+
+    template <typename Self, typename Visit>
+    static void forEachField(Self& config, Visit&& visit) {
+        visit("num_generations", config.numGenerations);
+        visit("population_size", config.populationSize);
+        visit("num_tries", config.numTries);
+        visit("num_steps", config.numSteps);
+        visit("elite_proportion", config.eliteProportion);
+        visit("crossed_proportion", config.crossedProportion);
+        visit("mutation_rate", config.mutationRate);
+        visit("mutation_strength", config.mutationStrength);
+        visit("initial_energy", config.initialEnergy);
+        visit("num_food_sources_large", config.numFoodSourcesLarge);
+        visit("max_dist_from_orig", config.maxDistFromOrig);
+        visit("growth_cost", config.world.growthCost);
+        visit("default_junction_energy", config.world.defaultJunctionEnergy);
+        visit("max_junction_energy", config.world.maxJunctionEnergy);
+        visit("min_junction_energy", config.world.minJunctionEnergy);
+        visit("max_tubes_per_junction", config.world.maxTubesPerJunction);
+        visit("tube_length", config.world.tubeLength);
+        visit("food_energy_absorb_rate", config.world.foodEnergyAbsorbRate);
+        visit("passive_energy_loss", config.world.passiveEnergyLoss);
+        visit("min_growth_energy", config.world.minGrowthEnergy);
+        visit("default_flow_rate", config.world.defaultFlowRate);
+        visit("flow_rate_change_step", config.world.flowRateChangeStep);
+        visit("max_tube_flow_rate", config.world.maxTubeFlowRate);
+        visit("min_tube_flow_rate", config.world.minTubeFlowRate);
+        visit("min_growth_angle_variance", config.world.minGrowthAngleVariance);
+        visit("min_growth_angle", config.world.minGrowthAngle);
+    }
+
+    int numElite() const {
+        return populationSize * eliteProportion;
+    }
+
+    int numCrossed() const {
+        return populationSize * crossedProportion;
+    }
+
+    // throws invalid_argument for an unknown key or a malformed value
+    void set(const string& key, const string& value) {
+        bool found = false;
+        forEachField(*this, [&](const char* name, auto& field) {
+            if (key != name) return;
+            found = true;
+            try {
+                parseValue(value, field);
+            } catch (const logic_error&) {
+                throw invalid_argument("Bad value '" + value + "' for " + key);
+            }
+        });
+        if (!found) throw invalid_argument("Unknown parameter " + key);
+    }
+
+    // throws invalid_argument if the run could not work with these values
+    void check() const {
+        if (numElite() < 1 || numElite() + numCrossed() > populationSize) {
+            throw invalid_argument("population_size, elite_proportion and crossed_proportion leave no room for an elite and its children");
+        }
+        if (numTries < 1 || numSteps < 0) throw invalid_argument("num_tries has to be at least 1 and num_steps not negative");
+        if (!(mutationRate >= 0 && mutationRate <= 1)) throw invalid_argument("mutation_rate is not a probability");
+        if (numFoodSourcesLarge < 0 || maxDistFromOrig < 0) throw invalid_argument("num_food_sources_large and max_dist_from_orig cannot be negative");
+        // the tube length is also the cell size of the worlds' grids
+        if (!(world.tubeLength > 0)) throw invalid_argument("tube_length has to be positive");
+    }
+
+    static void parseValue(const string& text, int& value) {
+        size_t used;
+        value = stoi(text, &used);
+        if (used != text.size()) throw invalid_argument(text);
+    }
+
+    static void parseValue(const string& text, float& value) {
+        size_t used;
+        value = stof(text, &used);
+        if (used != text.size()) throw invalid_argument(text);
+    }
+
+    static void parseValue(const string& text, double& value) {
+        size_t used;
+        value = stod(text, &used);
+        if (used != text.size()) throw invalid_argument(text);
+    }
+};
+
+static string trim(const string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos) return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Configuration given by args, applied in order: `key=value` sets a
+// parameter, anything else is a file of `key = value` lines (# starts a
+// comment). Throws invalid_argument on bad input.
+Config loadConfig(const vector<string>& args) {
+    Config config;
+    for (const string& arg : args) {
+        size_t eq = arg.find('=');
+        if (eq != string::npos) {
+            config.set(trim(arg.substr(0, eq)), trim(arg.substr(eq + 1)));
+            continue;
+        }
+        ifstream file(arg);
+        if (!file) throw invalid_argument("Could not open config file " + arg);
+        for (string line; getline(file, line);) {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+            eq = line.find('=');
+            if (eq == string::npos) throw invalid_argument("Expected key = value in " + arg + ": " + line);
+            config.set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        }
+    }
+    config.check();
+    return config;
+}
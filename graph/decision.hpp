@@ -7,7 +7,7 @@ using namespace std;
 struct GrowthDecisionNet {
 
     Genome genome;
-    FNN net;
+    FlatFNN<GROW_NET_DIMS> net;
     
     double growthProbability = 0.0;
     double growthAngle = 0.0;
@@ -16,9 +16,7 @@ struct GrowthDecisionNet {
 
     GrowthDecisionNet(const Genome& genome) {
 
-        auto net = FNN();
-        net.initialize(genome.getGrowNetWeights());
-        this->net = net;
+        net.initialize(genome.growNetWeights);
     }
     
     void decideAction(int numberOfInTubes,
@@ -31,7 +29,8 @@ struct GrowthDecisionNet {
                     bool touchingFoodSource,
                     const deque<int>& signalHistory) {
 
-        vector<double> input = {
+        // inputs after the signal history stay 0
+        array<double, GROW_NET_DIMS[0].first> input = {
             static_cast<double>(numberOfInTubes),
             static_cast<double>(numberOfOutTubes),
             averageInTubeAngle,
@@ -40,13 +39,13 @@ struct GrowthDecisionNet {
             static_cast<double>(touchingFoodSource)
         };
 
-        
+        int i = 6;
         for (int signal : signalHistory) {
             double signal_value = static_cast<double>(signal) / NUM_SIGNAL_TYPES;
-            input.push_back(signal_value);
+            input[i++] = signal_value;
         }
         
-        vector<double> pred = net.predict(input);
+        auto pred = net.predict(input);
         growthProbability = pred[0];
         growthAngle = pred[1] * 2.0 * M_PI;
         angleVariance = pred[2] * M_PI;
@@ -57,16 +56,14 @@ struct GrowthDecisionNet {
 struct FlowDecisionNet {
 
     Genome genome;
-    FNN net;
+    FlatFNN<FLOW_NET_DIMS> net;
 
     double increaseFlowProb = 0.0;
     double decreaseFlowProb = 0.0;
 
     FlowDecisionNet(const Genome& genome) {
 
-        auto net = FNN();
-        net.initialize(genome.getFlowNetWeights());
-        this->net = net;
+        net.initialize(genome.flowNetWeights);
     }
 
     void decideAction(double currentFlowRate,
@@ -74,14 +71,14 @@ struct FlowDecisionNet {
                     double outJunctionAverageFlowRate,
                     int signal) {
 
-        vector<double> input = {
+        array<double, FLOW_NET_DIMS[0].first> input = {
             currentFlowRate,
             inJunctionAverageFlowRate,
             outJunctionAverageFlowRate,
             static_cast<double>(signal) / SIGNAL_TYPES.size()
         };
 
-        vector<double> pred = net.predict(input);
+        auto pred = net.predict(input);
         increaseFlowProb = pred[0];
         decreaseFlowProb = pred[1];
     }
@@ -17,17 +17,17 @@
 using namespace std;
 
 
-vector<unique_ptr<World>> generateInitialPopulation(const Genome* initialGenome = nullptr) {
+vector<unique_ptr<World>> generateInitialPopulation(const Config& config, const Genome* initialGenome = nullptr) {
     vector<unique_ptr<World>> population;
 
-    int pop_size = POPULATION_SIZE;
+    int pop_size = config.populationSize;
 
     if (initialGenome != nullptr) {
         pop_size -= 1;
         vector<unique_ptr<Junction>> junctions;
-        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
-        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-        auto world = make_unique<World>(*initialGenome);
+        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
+        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+        auto world = make_unique<World>(*initialGenome, config.world);
         world->placeNewFoodSources(std::move(foodSources));
         world->placeNewJunctions(std::move(junctions));
         population.push_back(std::move(world));
@@ -36,9 +36,9 @@ vector<unique_ptr<World>> generateInitialPopulation(const Genome* initialGenome
     for (int i = 0; i < pop_size; i++) {
 
         vector<unique_ptr<Junction>> junctions;
-        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
-        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-        auto world = make_unique<World>(Genome());
+        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
+        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+        auto world = make_unique<World>(Genome(), config.world);
         world->placeNewFoodSources(std::move(foodSources));
         world->placeNewJunctions(std::move(junctions));
         population.push_back(std::move(world));
@@ -87,24 +87,24 @@ void crossOverGenomes(const Genome& parent1, const Genome& parent2, Genome& chil
     child.setGrowNetWights(child_weights);
 }
 
-vector<unique_ptr<World>> createNextGeneration(vector<unique_ptr<World>>& currentPopulation) {
+vector<unique_ptr<World>> createNextGeneration(vector<unique_ptr<World>>& currentPopulation, const Config& config) {
     
     vector<unique_ptr<World>> nextGeneration;
 
     // Select elite individuals
 
     // Copy elites
-    int numElite = POPULATION_SIZE * ELITE_PROPORTION;
+    int numElite = config.numElite();
     for (int i = 0; i < numElite; i++) {
         vector<unique_ptr<Junction>> junctions;
-        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
-        nextGeneration.push_back(make_unique<World>(currentPopulation[i]->getGenome()));
+        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
+        nextGeneration.push_back(make_unique<World>(currentPopulation[i]->getGenome(), config.world));
         nextGeneration.back()->placeNewFoodSources(std::move(foodSources));
         nextGeneration.back()->placeNewJunctions(std::move(junctions));
     }
 
-    int numCrossed = POPULATION_SIZE * CROSSED_PROPORTION;
+    int numCrossed = config.numCrossed();
     // Generate offspring through crossover and mutation
     while (nextGeneration.size() < numElite + numCrossed) {
         int parent1Idx = Random::randint(0, numElite - 1);
@@ -115,30 +115,30 @@ vector<unique_ptr<World>> createNextGeneration(vector<unique_ptr<World>>& curren
                          childGenome);
 
         // Mutate child genome
-        childGenome.mutate(DEFAULT_MUTATION_RATE, MUTATION_STRENGTH);
+        childGenome.mutate(config.mutationRate, config.mutationStrength);
 
         // Create new World with child genome
         vector<unique_ptr<Junction>> junctions;
-        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
+        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
 
-        auto childWorld = make_unique<World>(childGenome);
+        auto childWorld = make_unique<World>(childGenome, config.world);
         childWorld->placeNewFoodSources(std::move(foodSources));
         childWorld->placeNewJunctions(std::move(junctions));
         nextGeneration.push_back(std::move(childWorld));
     }
 
-    while (nextGeneration.size() < POPULATION_SIZE) {
+    while (nextGeneration.size() < static_cast<size_t>(config.populationSize)) {
         // Fill the rest of the population with mutated copies of elites
         int eliteIdx = Random::randint(0, numElite - 1);
         Genome mutatedGenome = currentPopulation[eliteIdx]->getGenome();
-        mutatedGenome.mutate(DEFAULT_MUTATION_RATE, MUTATION_STRENGTH);
+        mutatedGenome.mutate(config.mutationRate, config.mutationStrength);
 
         vector<unique_ptr<Junction>> junctions;
-        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
+        junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+        vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
 
-        nextGeneration.push_back(make_unique<World>(mutatedGenome));
+        nextGeneration.push_back(make_unique<World>(mutatedGenome, config.world));
         nextGeneration.back()->placeNewFoodSources(std::move(foodSources));
         nextGeneration.back()->placeNewJunctions(std::move(junctions));
     }
@@ -146,19 +146,19 @@ vector<unique_ptr<World>> createNextGeneration(vector<unique_ptr<World>>& curren
     return nextGeneration;
 }
 
-void printETA(int currentGeneration, const vector<chrono::duration<double>>& gen_durations) {
+void printETA(int currentGeneration, int numGenerations, const vector<chrono::duration<double>>& gen_durations) {
     if (gen_durations.empty()) return;
     double avg_gen_time = std::accumulate(gen_durations.begin(), gen_durations.end(), 0.0, [](double sum, const auto& d) { return sum + d.count(); }) / gen_durations.size();
-    double remaining_seconds = (NUM_GENERATIONS - currentGeneration - 1) * avg_gen_time;
+    double remaining_seconds = (numGenerations - currentGeneration - 1) * avg_gen_time;
     long long remaining = static_cast<long long>(remaining_seconds + 0.5); // round to nearest second
     long long hours = remaining / 3600;
     long long minutes = (remaining % 3600) / 60;
     cout << "Estimated time remaining: " << hours << " hours " << minutes << " minutes" << endl;
 }
 
-void runGeneticAlgorithm(Genome* initialGenome = nullptr, int startGen = 0) {
+void runGeneticAlgorithm(const Config& config, Genome* initialGenome = nullptr, int startGen = 0) {
 
-    vector<std::unique_ptr<World>> population = generateInitialPopulation(initialGenome);
+    vector<std::unique_ptr<World>> population = generateInitialPopulation(config, initialGenome);
 
     if (startGen == -1) {
         startGen = getLastGenerationNumber() + 1;
@@ -172,56 +172,54 @@ void runGeneticAlgorithm(Genome* initialGenome = nullptr, int startGen = 0) {
     // For timing
     vector<chrono::duration<double>> gen_durations;
 
-    for (int gen = startGen; gen < NUM_GENERATIONS; gen++) {
+    for (int gen = startGen; gen < config.numGenerations; gen++) {
 
         auto gen_start = std::chrono::high_resolution_clock::now();
 
         cout << "-------------------------------------" << endl;
-        cout << "Generation " << gen+1 << "/" << NUM_GENERATIONS << endl;
+        cout << "Generation " << gen+1 << "/" << config.numGenerations << endl;
         cout << "-------------------------------------" << endl;
         
         int count = 0;
         for (const auto& ind : population) {
 
-            // cout << "Individual " << count+1 << "/" << POPULATION_SIZE << endl;
+            // cout << "Individual " << count+1 << "/" << config.populationSize << endl;
 
             // progress bar
             string progBar = "[";
             count++;
 
             for (int i = 0; i < 30; i++) {
-                if (i < (static_cast<int>((static_cast<double>(count) / POPULATION_SIZE) * 30))) progBar += ">";
+                if (i < (static_cast<int>((static_cast<double>(count) / config.populationSize) * 30))) progBar += ">";
                 else progBar += " ";
             }
 
             vector<double> ind_fitnesses;
             
-            for (int t = 0; t < NUM_TRIES; t++) {
+            for (int t = 0; t < config.numTries; t++) {
 
-                string progText = "Ind " + to_string(count) + "/" + to_string(POPULATION_SIZE) + " | Try " + to_string(t+1) + "/" + to_string(NUM_TRIES);
+                string progText = "Ind " + to_string(count) + "/" + to_string(config.populationSize) + " | Try " + to_string(t+1) + "/" + to_string(config.numTries);
 
-                ind->run(NUM_STEPS, false);
+                ind->run(config.numSteps, false);
                 ind->calculateFitness();
                 ind_fitnesses.push_back(ind->fitness);
 
-                if (t < NUM_TRIES - 1) {
+                if (t < config.numTries - 1) {
                     // Reset world for next try
                     ind->fitness = 0.0;
                     ind->food_consumed = 0.0;
 
-                    ind->junctions.clear();
-                    ind->tubes.clear();
-                    ind->foodSources.clear();
+                    ind->clear();
 
                     vector<unique_ptr<Junction>> junctions;
-                    junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, INITIAL_ENERGY}));
-                    vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources();
+                    junctions.push_back(make_unique<Junction>(Junction{0.0, 0.0, config.initialEnergy}));
+                    vector<unique_ptr<FoodSource>> foodSources = createRandomizedFoodSources(config);
                     ind->junctions = std::move(junctions);
-                    ind->foodSources = std::move(foodSources);
+                    ind->placeNewFoodSources(std::move(foodSources));
                 }
 
                 cout << progText << "\n";
-                cout << progBar << "] " << static_cast<int>((static_cast<double>(count) / POPULATION_SIZE) * 100) << "%\n";
+                cout << progBar << "] " << static_cast<int>((static_cast<double>(count) / config.populationSize) * 100) << "%\n";
 
                 cout << "\033[2A";
 
@@ -229,7 +227,7 @@ void runGeneticAlgorithm(Genome* initialGenome = nullptr, int startGen = 0) {
 
             std::sort(ind_fitnesses.begin(), ind_fitnesses.end(), std::less<double>());
 
-            ind->fitness = std::accumulate(ind_fitnesses.begin(), ind_fitnesses.end(), 0.0) / NUM_TRIES; // fitness is the average
+            ind->fitness = std::accumulate(ind_fitnesses.begin(), ind_fitnesses.end(), 0.0) / config.numTries; // fitness is the average
         
             cout << "\033[2K\r";           // clear current line
             cout << "\033[1B\033[2K\r";    // move down, clear next line
@@ -261,26 +259,41 @@ void runGeneticAlgorithm(Genome* initialGenome = nullptr, int startGen = 0) {
         cout << "Best fitness: " << bestFitness << endl;
         cout << "Average fitness: " << averageFitness << endl;
 
-        population = createNextGeneration(population);
+        population = createNextGeneration(population, config);
 
         // ==== Timing and ETA ====
         auto gen_end = chrono::high_resolution_clock::now();
         gen_durations.push_back(gen_end - gen_start);
         cout << "Generation time: " << gen_durations.back().count() << " seconds.\n";
 
-        printETA(gen, gen_durations);
+        printETA(gen, config.numGenerations, gen_durations);
     }
 }
 
 int main(int argc, char* argv[]) {
 
+    vector<string> args(argv + 1, argv + argc);
+
+    // a leading number is the generation to load the genome of, the other
+    // arguments configure the run (see loadConfig)
+    bool resume = !args.empty() && regex_match(args.front(), regex("-?[0-9]+"));
+    int gen = resume ? stoi(args.front()) : 0;
+    if (resume) args.erase(args.begin());
+
+    Config config;
+    try {
+        config = loadConfig(args);
+    } catch (const invalid_argument& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
     // load genome by generation number
-    if (argc > 1) {
-        int gen = stoi(argv[1]);
+    if (resume) {
         Genome genome = readGenome(gen);
         if (gen != -1) deleteGenomeRecordsAfter(gen);
-        runGeneticAlgorithm(&genome, gen);
+        runGeneticAlgorithm(config, &genome, gen);
     } else {
-        runGeneticAlgorithm();
+        runGeneticAlgorithm(config);
     }
 }
\ No newline at end of file
@@ -1,26 +1,29 @@
 #include <vector>
+#include <array>
+#include <utility>
 #include "utils.hpp"
 
 const int MAX_SIGNAL_HISTORY_LENGTH = 4;
 const vector<int> SIGNAL_TYPES = {0, 1, 2, 3};
 const int NUM_SIGNAL_TYPES = SIGNAL_TYPES.size();
 
-const vector<pair<int, int>> GROW_NET_DIMS = {
+// (inputs, outputs) of each layer, constexpr so that FlatFNN is shaped by them
+inline constexpr array<pair<int, int>, 5> GROW_NET_DIMS = {{
     {MAX_SIGNAL_HISTORY_LENGTH + 8, 16},
     {16, 12},
     {12, 8},
     {8, 8},
     {8, 4}
-};
+}};
 
-const vector<pair<int, int>> FLOW_NET_DIMS = {
+inline constexpr array<pair<int, int>, 4> FLOW_NET_DIMS = {{
     {4, 5}, // 3 x 5
     {5, 6}, // 5 x 6
     {6, 4}, // 6 x 4
     {4, 2}  // 4 x 2
     // + 5 + 6 + 4 + 2
     // total: 94
-};
+}};
 
 using namespace std;
 
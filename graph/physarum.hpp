@@ -12,6 +12,8 @@
 using namespace std;
 
 #include "decision.hpp"
+#include "spatial_grid.hpp"
+#include "segment_kernels.hpp"
 
 const double GROWTH_COST = 0.0;
 const double DEFAULT_JUNCTION_ENERGY = 1.0;
@@ -31,6 +33,26 @@ const double MIN_TUBE_FLOW_RATE = 0.01 * MAX_JUNCTION_ENERGY;
 const double MIN_GROWTH_ANGLE_VARIANCE = 0.05 * M_PI * 2;
 const double MIN_GROWTH_ANGLE = 0.0 * M_PI * 2;
 
+// Physics of a world, by default the constants above; a run sets them
+// through its Config (see config.hpp).
+struct Params {
+    double growthCost = GROWTH_COST;
+    double defaultJunctionEnergy = DEFAULT_JUNCTION_ENERGY;
+    double maxJunctionEnergy = MAX_JUNCTION_ENERGY;
+    double minJunctionEnergy = MIN_JUNCTION_ENERGY;
+    int maxTubesPerJunction = MAX_TUBES_PER_JUNCTION;
+    double tubeLength = TUBE_LENGTH;
+    double foodEnergyAbsorbRate = FOOD_ENERGY_ABSORB_RATE;
+    double passiveEnergyLoss = PASSIVE_ENERGY_LOSS;
+    double minGrowthEnergy = MIN_GROWTH_ENERGY;
+    double defaultFlowRate = DEFAULT_FLOW_RATE;
+    double flowRateChangeStep = FLOW_RATE_CHANGE_STEP;
+    double maxTubeFlowRate = MAX_TUBE_FLOW_RATE;
+    double minTubeFlowRate = MIN_TUBE_FLOW_RATE;
+    double minGrowthAngleVariance = MIN_GROWTH_ANGLE_VARIANCE;
+    double minGrowthAngle = MIN_GROWTH_ANGLE;
+};
+
 struct Junction;
 struct Tube;
 struct FoodSource;
@@ -46,6 +68,8 @@ struct Tube {
 
     Junction* fromJunction;
     Junction* toJunction;
+
+    size_t id = 0; // tubes added to the world later have higher ids
 };    
 
 struct Junction {
@@ -149,24 +173,46 @@ struct FoodSource {
     const double y;
     const double radius;
     double energy;
+
+    size_t id = 0; // food sources placed later have higher ids
+
+    vector<Junction*> junctions; // touching it, in the order they were placed
+    bool depleted = false;       // depleted sources stay, but feed no longer
     // enum class FoodType { A, B, C } type;
 };
 
 struct World {
     Genome genome;
+    Params params;
 
     vector<unique_ptr<Junction>> junctions;
     vector<unique_ptr<Tube>> tubes;
     vector<unique_ptr<FoodSource>> foodSources;
 
+    // tubes by the grid cells their bounding boxes cover, for collisions;
+    // cells are as wide as a tube is long
+    SpatialGrid<Tube> tubeGrid{params.tubeLength};
+    size_t nextTubeId = 0;
+    vector<int> collisionHits;
+
+    // food sources by the grid cells their discs cover, cells as wide as
+    // the largest disc
+    SpatialGrid<FoodSource> foodGrid{params.tubeLength};
+    size_t nextFoodSourceId = 0;
+
+    // food sources touched by a junction and not depleted, and their number
+    vector<FoodSource*> occupiedFoodSources;
+    int discoveredFoodSources = 0;
+
     GrowthDecisionNet growthDecisionNet;
     FlowDecisionNet flowDecisionNet;
 
     double food_consumed = 0.0;
     double fitness = 0.0;
     
-    World(const Genome& g)
+    World(const Genome& g, const Params& params = Params())
         : genome(g),
+        params(params),
         growthDecisionNet(g),
         flowDecisionNet(g) {}
 
@@ -178,63 +224,127 @@ struct World {
         genome.mutate(mutation_rate, mutation_strength);
     }
 
+    // first food source (in the order of foodSources) whose disc contains
+    // the junction
     FoodSource* touchingFoodSource(const Junction& junc) {
-        for (const auto& fs : foodSources) {
-            double dist = sqrt((junc.x - fs->x) * (junc.x - fs->x) + (junc.y - fs->y) * (junc.y - fs->y));
-            if (dist <= fs->radius) {
-                return fs.get();
+        FoodSource* first = nullptr;
+        foodGrid.forEachCell(junc.x, junc.y, junc.x, junc.y, [&](const SpatialGrid<FoodSource>::Cell& cell) {
+            for (FoodSource* fs : cell.items) {
+                if (first != nullptr && fs->id >= first->id) continue;
+                double dx = junc.x - fs->x, dy = junc.y - fs->y;
+                double dist2 = dx * dx + dy * dy, radius2 = fs->radius * fs->radius;
+                // squared distances decide, except right on the rim (where
+                // junctions grown from the centre lie) where the sqrt
+                // comparison used before does, so contact does not change
+                bool touching = std::fabs(dist2 - radius2) > 1e-9 * radius2 ? dist2 < radius2 : sqrt(dist2) <= fs->radius;
+                if (touching) {
+                    first = fs;
+                }
             }
-        }
-        return nullptr;
+        });
+        return first;
     }
 
     FoodSource* getFoodSourceAt(const Junction& junc) {
-        for (const auto& fs : foodSources) {
-            double dist = sqrt((junc.x - fs->x) * (junc.x - fs->x) + (junc.y - fs->y) * (junc.y - fs->y));
-            if (dist <= fs->radius) {
-                return fs.get();
-            }
-        }
-        return nullptr;
+        return touchingFoodSource(junc);
+    }
+
+    void indexFoodSource(FoodSource* fs) {
+        foodGrid.insert(fs, fs->x - fs->radius, fs->y - fs->radius, fs->x + fs->radius, fs->y + fs->radius);
+    }
+
+    void unindexFoodSource(FoodSource* fs) {
+        foodGrid.remove(fs, fs->x - fs->radius, fs->y - fs->radius, fs->x + fs->radius, fs->y + fs->radius);
     }
 
     void placeNewFoodSources(vector<unique_ptr<FoodSource>>&& newFoodSources) {
         for (auto& fs : newFoodSources) {
+            fs->id = nextFoodSourceId++;
+            fs->depleted = fs->energy <= 1e-6;
             foodSources.push_back(std::move(fs));
         }
+
+        // the layout is static, so the index is built once per placement
+        double cellSize = params.tubeLength;
+        for (const auto& fs : foodSources) {
+            cellSize = max(cellSize, 2.0 * fs->radius);
+        }
+        foodGrid = SpatialGrid<FoodSource>(cellSize);
+        for (const auto& fs : foodSources) {
+            if (!fs->depleted) indexFoodSource(fs.get());
+        }
+    }
+
+    // links a new junction and the food source it touches, if any; called
+    // in the order junctions are added, so that a source's junctions are
+    // in that order too
+    void linkFoodSource(Junction& junc) {
+        junc.foodSource = getFoodSourceAt(junc);
+        FoodSource* fs = junc.foodSource;
+        if (fs == nullptr) return;
+
+        fs->junctions.push_back(&junc);
+        if (fs->junctions.size() == 1) {
+            occupiedFoodSources.push_back(fs);
+            discoveredFoodSources++;
+        }
     }
 
     void placeNewJunctions(vector<unique_ptr<Junction>>&& newJunctions) {
         for (auto& junc : newJunctions) {
             junctions.push_back(std::move(junc));
-            junctions.back()->foodSource = getFoodSourceAt(*junctions.back());
+            linkFoodSource(*junctions.back());
         }
     }
 
+    void clear() {
+        junctions.clear();
+        tubes.clear();
+        foodSources.clear();
+        tubeGrid.clear();
+        foodGrid.clear();
+        occupiedFoodSources.clear();
+        discoveredFoodSources = 0;
+    }
+
+    void addTube(unique_ptr<Tube>&& tube) {
+        tube->id = nextTubeId++;
+        tubeGrid.insert(tube.get(), tube->x1, tube->y1, tube->x2, tube->y2);
+        tubes.push_back(std::move(tube));
+    }
+
+    // tubes stay ordered by id, so the tube is found by binary search
+    void removeTube(Tube* tube) {
+        tubeGrid.remove(tube, tube->x1, tube->y1, tube->x2, tube->y2);
+        auto it = std::lower_bound(tubes.begin(), tubes.end(), tube->id,
+            [](const unique_ptr<Tube>& t, size_t id) { return t->id < id; });
+        tubes.erase(it);
+    }
+
     void growTubeFrom(Junction& from, double angle) {
 
-        double newX = from.x + TUBE_LENGTH * cos(angle);
-        double newY = from.y + TUBE_LENGTH * sin(angle);
+        double newX = from.x + params.tubeLength * cos(angle);
+        double newY = from.y + params.tubeLength * sin(angle);
 
         auto collisionInfo = getCollisionInfo(from, newX, newY);
 
         // if no collision, create new junction and tube
         if (collisionInfo.tube == nullptr) {
 
-            auto newJunction = std::make_unique<Junction>(Junction{newX, newY, DEFAULT_JUNCTION_ENERGY});
+            auto newJunction = std::make_unique<Junction>(Junction{newX, newY, params.defaultJunctionEnergy});
             Junction* newJuncPtr = newJunction.get();
 
             auto newTube = std::make_unique<Tube>(Tube{
-                from.x, from.y, newX, newY, DEFAULT_FLOW_RATE, &from, newJuncPtr
+                from.x, from.y, newX, newY, params.defaultFlowRate, &from, newJuncPtr
             });
 
             // connect tubes to junctions
             from.outTubes.push_back({ newTube.get(), angle });
             newJuncPtr->inTubes.push_back({ newTube.get(), angle });
 
-            newJuncPtr->foodSource = touchingFoodSource(*newJunction);
+            linkFoodSource(*newJuncPtr);
             // add to world
-            tubes.push_back(std::move(newTube));
+            addTube(std::move(newTube));
             junctions.push_back(std::move(newJunction));
 
         // if collision, create intersection junction and split existing tube
@@ -243,13 +353,13 @@ struct World {
             newX = *collisionInfo.x;
             newY = *collisionInfo.y;
 
-            auto newJunction = std::make_unique<Junction>(Junction{newX, newY, DEFAULT_JUNCTION_ENERGY});
+            auto newJunction = std::make_unique<Junction>(Junction{newX, newY, params.defaultJunctionEnergy});
             Junction* newJuncPtr = newJunction.get();
 
-            newJuncPtr->foodSource = touchingFoodSource(*newJunction);
+            linkFoodSource(*newJuncPtr);
 
             auto newTube = std::make_unique<Tube>(Tube{
-                from.x, from.y, newX, newY, DEFAULT_FLOW_RATE, &from, newJuncPtr
+                from.x, from.y, newX, newY, params.defaultFlowRate, &from, newJuncPtr
             });
             
             // split the existing tube at the intersection point and connect both pieces to the new junction
@@ -289,54 +399,31 @@ struct World {
             replaceAll(origTo, existing, segB.get());
 
             // remove the original existing tube from the world's tubes vector
-            tubes.erase(std::remove_if(tubes.begin(), tubes.end(), [&](const std::unique_ptr<Tube>& t) { return t.get() == existing; }),
-            tubes.end());
+            removeTube(existing);
             
             // add updated objects to world
-            tubes.push_back(std::move(newTube));
-            tubes.push_back(std::move(segA));
-            tubes.push_back(std::move(segB));
+            addTube(std::move(newTube));
+            addTube(std::move(segA));
+            addTube(std::move(segB));
             junctions.push_back(std::move(newJunction));
         }
 
-        from.energy -= DEFAULT_JUNCTION_ENERGY; // energy passed to new junction
-        from.energy -= GROWTH_COST; // cost of growing
+        from.energy -= params.defaultJunctionEnergy; // energy passed to new junction
+        from.energy -= params.growthCost; // cost of growing
 
-        from.energy = max(from.energy, MIN_JUNCTION_ENERGY);
+        from.energy = max(from.energy, params.minJunctionEnergy);
     }
 
     // Axis-aligned bounding box overlap check
     bool bboxOverlap(double x1a, double y1a, double x2a, double y2a,
                      double x1b, double y1b, double x2b, double y2b) {
-        double minAx = std::min(x1a, x2a), maxAx = std::max(x1a, x2a);
-        double minAy = std::min(y1a, y2a), maxAy = std::max(y1a, y2a);
-        double minBx = std::min(x1b, x2b), maxBx = std::max(x1b, x2b);
-        double minBy = std::min(y1b, y2b), maxBy = std::max(y1b, y2b);
-
-        return !(maxAx < minBx || maxBx < minAx || maxAy < minBy || maxBy < minAy);
+        return boxesOverlap(x1a, y1a, x2a, y2a, x1b, y1b, x2b, y2b);
     }
 
     optional<pair<double, double>> getSegmentIntersection(
         double x1, double y1, double x2, double y2,
         double x3, double y3, double x4, double y4) {
-        double denom = (x1 - x2) * (y3 - y4) - (y1 - y2) * (x3 - x4);
-        if (std::fabs(denom) < 1e-9) return std::nullopt; // parallel or coincident
-
-        double px = ((x1 * y2 - y1 * x2) * (x3 - x4) - 
-                    (x1 - x2) * (x3 * y4 - y3 * x4)) / denom;
-        double py = ((x1 * y2 - y1 * x2) * (y3 - y4) - 
-                    (y1 - y2) * (x3 * y4 - y3 * x4)) / denom;
-
-        auto within = [](double a, double b, double c) {
-            return c >= std::min(a, b) - 1e-9 && c <= std::max(a, b) + 1e-9;
-        };
-
-        if (within(x1, x2, px) && within(y1, y2, py) &&
-            within(x3, x4, px) && within(y3, y4, py)) {
-            return std::make_pair(px, py);
-        }
-
-        return std::nullopt;
+        return segmentIntersection(x1, y1, x2, y2, x3, y3, x4, y4);
     }
 
 
@@ -346,18 +433,29 @@ struct World {
         Tube* tube = nullptr;
     };
 
+    // first tube (in the order of tubes) the segment from fromJunc to
+    // (newX, newY) crosses; only tubes sharing a grid cell with it are
+    // tested, a cell's tubes in one batch
     CollisionInfo getCollisionInfo(Junction& fromJunc, double& newX, double& newY) {
 
-        for (const auto& tube : tubes) {
-            if ((tube->fromJunction == &fromJunc) || (tube->toJunction == &fromJunc)) continue;
-            if (!bboxOverlap(fromJunc.x, fromJunc.y, newX, newY, tube->x1, tube->y1, tube->x2, tube->y2)) continue;
+        CollisionInfo first;
+        tubeGrid.forEachCell(fromJunc.x, fromJunc.y, newX, newY, [&](const SpatialGrid<Tube>::Cell& cell) {
+            collisionHits.clear();
+            crossedSegments(fromJunc.x, fromJunc.y, newX, newY,
+                            cell.x1.data(), cell.y1.data(), cell.x2.data(), cell.y2.data(), cell.size(), collisionHits);
+
+            for (int i : collisionHits) {
+                Tube* tube = cell.items[i];
+                if (first.tube != nullptr && tube->id >= first.tube->id) continue;
+                if ((tube->fromJunction == &fromJunc) || (tube->toJunction == &fromJunc)) continue;
 
-            // calculate intersection
-            if (auto intersection = getSegmentIntersection(fromJunc.x, fromJunc.y, newX, newY, tube->x1, tube->y1, tube->x2, tube->y2)) {
-                return CollisionInfo{intersection->first, intersection->second, tube.get()};
+                // calculate intersection
+                if (auto intersection = getSegmentIntersection(fromJunc.x, fromJunc.y, newX, newY, tube->x1, tube->y1, tube->x2, tube->y2)) {
+                    first = CollisionInfo{intersection->first, intersection->second, tube};
+                }
             }
-        }
-        return {std::nullopt, std::nullopt, nullptr};
+        });
+        return first;
     }
 
 
@@ -434,6 +532,7 @@ struct World {
                  << ",,,\n";
         }
         for (const auto& fs : foodSources) {
+            if (fs->depleted) continue;
             file << step << ','
                  << fitness << ",,,,,,";
                  for (size_t j = 0; j < MAX_SIGNAL_HISTORY_LENGTH; ++j)
@@ -460,7 +559,7 @@ struct World {
             Junction* junc = junctions[i].get();
 
             // outgoing tubes
-            if (junc->energy <= MIN_JUNCTION_ENERGY) continue; // depleted junctions can't send energy or grow
+            if (junc->energy <= params.minJunctionEnergy) continue; // depleted junctions can't send energy or grow
             for (auto& outTubeInfo : junc->outTubes) {
                 Tube* tube = outTubeInfo.tube;
 
@@ -470,8 +569,8 @@ struct World {
                 tube->toJunction->energy += energyAmount;
                 tube->toJunction->saveSignal(junc->signal);
 
-                tube->toJunction->energy = min(tube->toJunction->energy, MAX_JUNCTION_ENERGY);
-                junc->energy = max(junc->energy, MIN_JUNCTION_ENERGY);
+                tube->toJunction->energy = min(tube->toJunction->energy, params.maxJunctionEnergy);
+                junc->energy = max(junc->energy, params.minJunctionEnergy);
             }
 
             // handle growth decision
@@ -480,7 +579,7 @@ struct World {
             int numOutTubes = junc->numOutTubes();
             double averageAngleIn = junc->averageAngleInTubes();
             double averageAngleOut = junc->averageAngleOutTubes();
-            double energy = junc->energy  / MAX_JUNCTION_ENERGY; // normalize energy input
+            double energy = junc->energy  / params.maxJunctionEnergy; // normalize energy input
             bool touchingFoodSource = junc->isTouchingFoodSource();
             deque<int> signalHistory = junc->signalHistory;
             
@@ -494,19 +593,19 @@ struct World {
                                             touchingFoodSource,
                                             signalHistory);
                
-            if (junc->getTotalTubes() < MAX_TUBES_PER_JUNCTION && Random::uniform() < growthDecisionNet.growthProbability && junc->energy > MIN_GROWTH_ENERGY) {
-                double variance = max(growthDecisionNet.angleVariance, MIN_GROWTH_ANGLE_VARIANCE);
+            if (junc->getTotalTubes() < params.maxTubesPerJunction && Random::uniform() < growthDecisionNet.growthProbability && junc->energy > params.minGrowthEnergy) {
+                double variance = max(growthDecisionNet.angleVariance, params.minGrowthAngleVariance);
                 double angle = 
                     averageAngleIn + 
                     growthDecisionNet.growthAngle +
                     Random::uniform(-variance, variance);
                 
-                growTubeFrom(*junc, max(MIN_GROWTH_ANGLE, angle));
+                growTubeFrom(*junc, max(params.minGrowthAngle, angle));
             }
 
             junc->signal = growthDecisionNet.signal;
-            junc->energy -= PASSIVE_ENERGY_LOSS;
-            junc->energy = max(junc->energy, MIN_JUNCTION_ENERGY);
+            junc->energy -= params.passiveEnergyLoss;
+            junc->energy = max(junc->energy, params.minJunctionEnergy);
         }        
     }
     
@@ -526,11 +625,11 @@ struct World {
                                         signal);
             // adjust flow rate based on decision net
             if (Random::uniform() < flowDecisionNet.increaseFlowProb) {
-                tube->flowRate += FLOW_RATE_CHANGE_STEP;
-                tube->flowRate = min(tube->flowRate, MAX_TUBE_FLOW_RATE);
+                tube->flowRate += params.flowRateChangeStep;
+                tube->flowRate = min(tube->flowRate, params.maxTubeFlowRate);
             }
             if (Random::uniform() < flowDecisionNet.decreaseFlowProb && tube->flowRate > 0) {
-                tube->flowRate -= FLOW_RATE_CHANGE_STEP;
+                tube->flowRate -= params.flowRateChangeStep;
             }
 
             // rearrange tube direction if flow rate changes to negative
@@ -541,46 +640,46 @@ struct World {
                 tube->toJunction->switchTubeDirection(*tube);
             }
             tube->flowRate = min(tube->flowRate, tube->fromJunction->energy); // limit by available energy    
-            tube->flowRate = max(tube->flowRate, MIN_TUBE_FLOW_RATE);
+            tube->flowRate = max(tube->flowRate, params.minTubeFlowRate);
         }
     }
 
-    void deleteDepleetedFoodSources() {
-        // remove food sources with energy <= 0
-        foodSources.erase(
-            std::remove_if(foodSources.begin(), foodSources.end(),
-                [](const std::unique_ptr<FoodSource>& fs) {
-                    return fs->energy <= 1e-6;
-                }),
-                foodSources.end());
+    void markDepleted(FoodSource* fs) {
+        fs->depleted = true;
+        unindexFoodSource(fs);
     }
 
     void updateFood() {
 
-        for (auto& foodSource : foodSources) {
-            
-            for (auto& junc : junctions) {
+        for (size_t i = 0; i < occupiedFoodSources.size();) {
+            FoodSource* fs = occupiedFoodSources[i];
 
-                if (junc->foodSource == foodSource.get()) {
-                    if (junc->energy == MAX_JUNCTION_ENERGY)
-                        continue;
+            for (Junction* junc : fs->junctions) {
 
-                    FoodSource* fs = junc->foodSource; // keep the pointer
+                if (junc->energy == params.maxJunctionEnergy)
+                    continue;
 
-                    fs->energy -= FOOD_ENERGY_ABSORB_RATE;
-                    food_consumed += FOOD_ENERGY_ABSORB_RATE;
+                fs->energy -= params.foodEnergyAbsorbRate;
+                food_consumed += params.foodEnergyAbsorbRate;
 
-                    
-                    junc->energy += FOOD_ENERGY_ABSORB_RATE;
+                
+                junc->energy += params.foodEnergyAbsorbRate;
 
-                    junc->energy = min(junc->energy, MAX_JUNCTION_ENERGY);
-                    // only one junction can feed on foodsource -> go to next food source
-                    break;
-                }
+                junc->energy = min(junc->energy, params.maxJunctionEnergy);
+                // only one junction can feed on foodsource -> go to next food source
+                break;
             }
-        }
 
-        deleteDepleetedFoodSources();
+            // depleted sources are no longer found or counted as discovered
+            if (fs->energy <= 1e-6) {
+                markDepleted(fs);
+                discoveredFoodSources--;
+                occupiedFoodSources[i] = occupiedFoodSources.back();
+                occupiedFoodSources.pop_back();
+            } else {
+                i++;
+            }
+        }
     }
 
     void updateFitness() {
@@ -590,14 +689,6 @@ struct World {
     void calculateFitness() {
 
         // number of food sources discovered fitness
-        fitness = 0.0;
-        for (const auto& fs : foodSources) {
-            for (const auto& junc : junctions) {
-                if (junc->foodSource == fs.get()) {
-                    fitness += 1.0;
-                    break;
-                }
-            }
-        }
+        fitness = discoveredFoodSources;
     }
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Segment intersection tests, one at a time and batched over segments kept
+// in contiguous coordinate arrays. Both do the same floating point
+// operations in the same order, and multiply-adds are not fused, so a
+// batched test hits exactly the segments the single test hits. Builds
+// without FMA (e.g. -O2, -mavx2) give the results of the earlier unbatched
+// code; with FMA enabled (-march=native on most machines) that code let the
+// compiler fuse, so intersection points differ in the last bits and
+// simulations diverge from its results.
+
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Axis-aligned bounding box overlap check
+inline bool boxesOverlap(double x1a, double y1a, double x2a, double y2a,
+                         double x1b, double y1b, double x2b, double y2b) {
+    double minAx = std::min(x1a, x2a), maxAx = std::max(x1a, x2a);
+    double minAy = std::min(y1a, y2a), maxAy = std::max(y1a, y2a);
+    double minBx = std::min(x1b, x2b), maxBx = std::max(x1b, x2b);
+    double minBy = std::min(y1b, y2b), maxBy = std::max(y1b, y2b);
+
+    return !(maxAx < minBx || maxBx < minAx || maxAy < minBy || maxBy < minAy);
+}
+
+inline optional<pair<double, double>> segmentIntersection(
+    double x1, double y1, double x2, double y2,
+    double x3, double y3, double x4, double y4) {
+    double denom = (x1 - x2) * (y3 - y4) - (y1 - y2) * (x3 - x4);
+    if (std::fabs(denom) < 1e-9) return std::nullopt; // parallel or coincident
+
+    double px = ((x1 * y2 - y1 * x2) * (x3 - x4) -
+                (x1 - x2) * (x3 * y4 - y3 * x4)) / denom;
+    double py = ((x1 * y2 - y1 * x2) * (y3 - y4) -
+                (y1 - y2) * (x3 * y4 - y3 * x4)) / denom;
+
+    auto within = [](double a, double b, double c) {
+        return c >= std::min(a, b) - 1e-9 && c <= std::max(a, b) + 1e-9;
+    };
+
+    if (within(x1, x2, px) && within(y1, y2, py) &&
+        within(x3, x4, px) && within(y3, y4, py)) {
+        return std::make_pair(px, py);
+    }
+
+    return std::nullopt;
+}
+
+inline bool segmentsCross(double x1, double y1, double x2, double y2,
+                          double x3, double y3, double x4, double y4) {
+    return boxesOverlap(x1, y1, x2, y2, x3, y3, x4, y4)
+        && segmentIntersection(x1, y1, x2, y2, x3, y3, x4, y4).has_value();
+}
+
+// appends to hits the indices i < n of the segments (x1[i], y1[i]) -
+// (x2[i], y2[i]) that the segment (ax, ay) - (bx, by) crosses, in order
+inline void crossedSegments(double ax, double ay, double bx, double by,
+                            const double* x1, const double* y1, const double* x2, const double* y2,
+                            int n, vector<int>& hits) {
+    int i = 0;
+#ifdef __AVX2__
+    const __m256d eps = _mm256_set1_pd(1e-9);
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+
+    const __m256d minAx = _mm256_set1_pd(std::min(ax, bx)), maxAx = _mm256_set1_pd(std::max(ax, bx));
+    const __m256d minAy = _mm256_set1_pd(std::min(ay, by)), maxAy = _mm256_set1_pd(std::max(ay, by));
+    const __m256d dAx = _mm256_set1_pd(ax - bx), dAy = _mm256_set1_pd(ay - by);
+    const __m256d crossA = _mm256_set1_pd(ax * by - ay * bx);
+    // bounds of the point on the new segment, as within() widens them
+    const __m256d loAx = _mm256_sub_pd(minAx, eps), hiAx = _mm256_add_pd(maxAx, eps);
+    const __m256d loAy = _mm256_sub_pd(minAy, eps), hiAy = _mm256_add_pd(maxAy, eps);
+
+    for (; i + 4 <= n; i += 4) {
+        __m256d X3 = _mm256_loadu_pd(x1 + i), Y3 = _mm256_loadu_pd(y1 + i);
+        __m256d X4 = _mm256_loadu_pd(x2 + i), Y4 = _mm256_loadu_pd(y2 + i);
+
+        __m256d minBx = _mm256_min_pd(X3, X4), maxBx = _mm256_max_pd(X3, X4);
+        __m256d minBy = _mm256_min_pd(Y3, Y4), maxBy = _mm256_max_pd(Y3, Y4);
+        __m256d overlap = _mm256_and_pd(
+            _mm256_and_pd(_mm256_cmp_pd(maxAx, minBx, _CMP_GE_OQ), _mm256_cmp_pd(maxBx, minAx, _CMP_GE_OQ)),
+            _mm256_and_pd(_mm256_cmp_pd(maxAy, minBy, _CMP_GE_OQ), _mm256_cmp_pd(maxBy, minAy, _CMP_GE_OQ)));
+        if (_mm256_movemask_pd(overlap) == 0) continue;
+
+        __m256d dBx = _mm256_sub_pd(X3, X4), dBy = _mm256_sub_pd(Y3, Y4);
+        __m256d denom = _mm256_sub_pd(_mm256_mul_pd(dAx, dBy), _mm256_mul_pd(dAy, dBx));
+        __m256d notParallel = _mm256_cmp_pd(_mm256_andnot_pd(signBit, denom), eps, _CMP_GE_OQ);
+
+        __m256d crossB = _mm256_sub_pd(_mm256_mul_pd(X3, Y4), _mm256_mul_pd(Y3, X4));
+        __m256d px = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(crossA, dBx), _mm256_mul_pd(dAx, crossB)), denom);
+        __m256d py = _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(crossA, dBy), _mm256_mul_pd(dAy, crossB)), denom);
+
+        __m256d onA = _mm256_and_pd(
+            _mm256_and_pd(_mm256_cmp_pd(px, loAx, _CMP_GE_OQ), _mm256_cmp_pd(px, hiAx, _CMP_LE_OQ)),
+            _mm256_and_pd(_mm256_cmp_pd(py, loAy, _CMP_GE_OQ), _mm256_cmp_pd(py, hiAy, _CMP_LE_OQ)));
+        __m256d onB = _mm256_and_pd(
+            _mm256_and_pd(_mm256_cmp_pd(px, _mm256_sub_pd(minBx, eps), _CMP_GE_OQ), _mm256_cmp_pd(px, _mm256_add_pd(maxBx, eps), _CMP_LE_OQ)),
+            _mm256_and_pd(_mm256_cmp_pd(py, _mm256_sub_pd(minBy, eps), _CMP_GE_OQ), _mm256_cmp_pd(py, _mm256_add_pd(maxBy, eps), _CMP_LE_OQ)));
+
+        int mask = _mm256_movemask_pd(_mm256_and_pd(_mm256_and_pd(overlap, notParallel), _mm256_and_pd(onA, onB)));
+        while (mask != 0) {
+            hits.push_back(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (segmentsCross(ax, ay, bx, by, x1[i], y1[i], x2[i], y2[i])) hits.push_back(i);
+    }
+}
+
+#if defined(__clang__)
+#pragma clang fp contract(on)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
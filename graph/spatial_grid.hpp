@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+using namespace std;
+
+// Uniform grid over the plane, hashed so that it has no bounds. Items are
+// filed under every cell their bounding box covers, together with the
+// coordinates they were inserted with, which a cell keeps in contiguous
+// arrays for batched tests. Lookups visit the cells a box covers, so an
+// item covering several of them is seen once per cell.
+template <typename T>
+struct SpatialGrid {
+
+    struct Cell {
+        vector<T*> items;
+        vector<double> x1, y1, x2, y2; // of items[i]
+
+        int size() const {
+            return items.size();
+        }
+    };
+
+    double cellSize;
+    unordered_map<uint64_t, Cell> cells;
+
+    SpatialGrid(double cellSize) : cellSize(cellSize) {}
+
+    int cellOf(double coord) const {
+        return static_cast<int>(floor(coord / cellSize));
+    }
+
+    static uint64_t key(int cx, int cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    template <typename Visit>
+    void forEachKey(double x1, double y1, double x2, double y2, Visit&& visit) const {
+        int minCx = cellOf(min(x1, x2)), maxCx = cellOf(max(x1, x2));
+        int minCy = cellOf(min(y1, y2)), maxCy = cellOf(max(y1, y2));
+        for (int cx = minCx; cx <= maxCx; ++cx) {
+            for (int cy = minCy; cy <= maxCy; ++cy) {
+                visit(key(cx, cy));
+            }
+        }
+    }
+
+    // visits the non-empty cells the box covers
+    template <typename Visit>
+    void forEachCell(double x1, double y1, double x2, double y2, Visit&& visit) const {
+        forEachKey(x1, y1, x2, y2, [&](uint64_t k) {
+            auto it = cells.find(k);
+            if (it != cells.end() && !it->second.items.empty()) visit(it->second);
+        });
+    }
+
+    void insert(T* item, double x1, double y1, double x2, double y2) {
+        forEachKey(x1, y1, x2, y2, [&](uint64_t k) {
+            Cell& cell = cells[k];
+            cell.items.push_back(item);
+            cell.x1.push_back(x1);
+            cell.y1.push_back(y1);
+            cell.x2.push_back(x2);
+            cell.y2.push_back(y2);
+        });
+    }
+
+    // the coordinates have to be the ones the item was inserted with
+    void remove(T* item, double x1, double y1, double x2, double y2) {
+        forEachKey(x1, y1, x2, y2, [&](uint64_t k) {
+            auto it = cells.find(k);
+            if (it == cells.end()) return;
+            Cell& cell = it->second;
+            auto pos = std::find(cell.items.begin(), cell.items.end(), item);
+            if (pos == cell.items.end()) return;
+            size_t i = pos - cell.items.begin();
+            cell.items[i] = cell.items.back();
+            cell.x1[i] = cell.x1.back();
+            cell.y1[i] = cell.y1.back();
+            cell.x2[i] = cell.x2.back();
+            cell.y2[i] = cell.y2.back();
+            cell.items.pop_back();
+            cell.x1.pop_back();
+            cell.y1.pop_back();
+            cell.x2.pop_back();
+            cell.y2.pop_back();
+        });
+    }
+
+    void clear() {
+        cells.clear();
+    }
+};